@@ -3,81 +3,478 @@
 #include "miniaudio.h"
 #include "utils.h"
 #include "logging.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AUDIO_USE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AUDIO_USE_NEON
+#endif
+
 // Fixed Whisper configuration (16kHz mono)
 #define WHISPER_SAMPLE_RATE 16000
 #define WHISPER_CHANNELS 1
 
+// Capture ring between the audio thread and the drain thread.
+// Sized so the drain thread can stall for a few seconds without losing frames.
+#define CAPTURE_RING_SECONDS 4
+#define DRAIN_INTERVAL_MS 10
+
+// Low-latency device period so the first frame arrives quickly after start
+#define CAPTURE_PERIOD_MS 10
+
+// Recording storage
+#define INITIAL_BUFFER_SAMPLES (WHISPER_SAMPLE_RATE * WHISPER_CHANNELS * 10) // 10 seconds
+#define CHUNK_SAMPLES (WHISPER_SAMPLE_RATE * WHISPER_CHANNELS * 2)           // Compact mode segment size
+#define POOL_SIZE 2                                                         // Spare float buffers kept for reuse
+// Shrink policy - storage beyond this is freed instead of kept after a long recording
+#define POOL_KEEP_SAMPLES (WHISPER_SAMPLE_RATE * WHISPER_CHANNELS * 60)
+
+// Pooled float buffers carry their capacity in a header in front of the samples.
+// 16 bytes keeps the samples aligned for SIMD.
+typedef struct {
+    size_t capacity;
+    size_t reserved;
+} BufferHeader;
+
+// Compact mode stores samples as int16 in fixed-size segments, so growing
+// never reallocates or copies and memory is half that of float
+typedef struct AudioChunk {
+    struct AudioChunk *next;
+    int16_t samples[CHUNK_SAMPLES];
+} AudioChunk;
+
 // Audio recorder structure
 typedef struct {
     ma_device device;
     ma_encoder encoder;
 
-    // Buffer recording
-    float *buffer;
-    size_t buffer_size;
-    size_t buffer_capacity;
-    size_t write_position;
+    // Lock-free SPSC ring - the audio thread is the only producer,
+    // whoever holds consumer_mutex the only consumer
+    ma_pcm_rb ring;
+    int dropped_frames; // Written by audio thread, read by main thread
+
+    // Drain thread moves ring contents into the buffer, encoder or pre-roll history
+    utils_thread_t *drain_thread;
+    bool drain_running;            // Atomic access required
+    utils_mutex_t *consumer_mutex; // Serializes the drain thread against start/stop
+
+    // Recording storage - only touched with consumer_mutex held
+    bool compact;        // int16 segments instead of a contiguous float buffer
+    float *buffer;       // Float mode: pooled buffer, handed off without copying
+    AudioChunk *chunks;  // Compact mode: recorded segments, oldest first
+    AudioChunk *chunks_tail;
+    AudioChunk *free_chunks;
+    int n_free_chunks;
+    size_t buffer_size;  // Samples recorded in either mode
+    float *spares[POOL_SIZE];
+    int n_spares;
+
+    // Downstream consumer of recorded samples (e.g. streaming VAD)
+    audio_samples_callback samples_callback;
+
+    // Always-on capture - the device keeps running between recordings and
+    // the most recent samples are kept so a recording can start in the past
+    bool always_on;
+    float *preroll;
+    size_t preroll_capacity; // In samples
+    size_t preroll_position; // Next write index
+    size_t preroll_fill;     // Valid samples in history
 
     // State - accessed from both audio and main threads
+    bool is_capturing;      // Atomic access required, gates the data callback
     bool is_recording;      // Atomic access required
     bool is_file_recording; // Atomic access required
     char *filename;
 
     // Timing
     ma_uint64 start_time;
-    ma_uint64 total_frames; // Written by audio thread, read by main thread
+    int total_frames;         // Written by consumer side, read by main thread
+    double press_time;        // When audio_recorder_start() was called
+    double first_frame_time;  // Written by audio thread before clearing first_frame_pending
+    bool first_frame_pending; // Atomic access required
 } AudioRecorder;
 
 // Global singleton instance
 static AudioRecorder *g_recorder = NULL;
 
-// Callback for audio input
+// Callback for audio input - runs on the real-time audio thread.
+// Must not allocate, lock or do I/O; it only appends to the ring.
 void data_callback(ma_device *pDevice, void *pOutput, const void *pInput, ma_uint32 frameCount) {
     AudioRecorder *recorder = (AudioRecorder *) pDevice->pUserData;
 
-    if (!recorder || !utils_atomic_read_bool(&recorder->is_recording) || !pInput) {
+    if (!recorder || !utils_atomic_read_bool(&recorder->is_capturing) || !pInput) {
         return;
     }
 
+    if (utils_atomic_read_bool(&recorder->first_frame_pending)) {
+        recorder->first_frame_time = utils_get_time();
+        utils_atomic_write_bool(&recorder->first_frame_pending, false);
+    }
+
     const float *input = (const float *) pInput;
-    size_t samples = frameCount * WHISPER_CHANNELS;
+    ma_uint32 remaining = frameCount;
+
+    // The ring may wrap, so the write can take two contiguous pieces
+    while (remaining > 0) {
+        ma_uint32 frames = remaining;
+        void *dst = NULL;
+        if (ma_pcm_rb_acquire_write(&recorder->ring, &frames, &dst) != MA_SUCCESS || frames == 0) {
+            break;
+        }
+        memcpy(dst, input, frames * WHISPER_CHANNELS * sizeof(float));
+        ma_pcm_rb_commit_write(&recorder->ring, frames);
+
+        input += frames * WHISPER_CHANNELS;
+        remaining -= frames;
+    }
+
+    // Ring full - the drain thread fell behind
+    if (remaining > 0) {
+        utils_atomic_write_int(&recorder->dropped_frames,
+                               utils_atomic_read_int(&recorder->dropped_frames) + (int) remaining);
+    }
+
+    (void) pOutput; // Unused
+}
+
+// Pooled float buffer helpers
+static float *pool_alloc(size_t capacity) {
+    BufferHeader *header = (BufferHeader *) malloc(sizeof(BufferHeader) + capacity * sizeof(float));
+    if (!header) {
+        return NULL;
+    }
+    header->capacity = capacity;
+    return (float *) (header + 1);
+}
+
+static BufferHeader *pool_header(float *data) {
+    return ((BufferHeader *) data) - 1;
+}
+
+static void pool_free(float *data) {
+    if (data) {
+        free(pool_header(data));
+    }
+}
 
-    if (utils_atomic_read_bool(&recorder->is_file_recording)) {
-        // Write to file
-        ma_encoder_write_pcm_frames(&recorder->encoder, pInput, frameCount, NULL);
+// Get a spare buffer that holds at least min_capacity samples
+static float *pool_get(AudioRecorder *recorder, size_t min_capacity) {
+    for (int i = 0; i < recorder->n_spares; i++) {
+        if (pool_header(recorder->spares[i])->capacity >= min_capacity) {
+            float *data = recorder->spares[i];
+            recorder->spares[i] = recorder->spares[--recorder->n_spares];
+            return data;
+        }
+    }
+    return pool_alloc(min_capacity > INITIAL_BUFFER_SAMPLES ? min_capacity : INITIAL_BUFFER_SAMPLES);
+}
+
+// Return a buffer to the pool, dropping oversized ones so one long
+// dictation doesn't stay resident forever
+static void pool_put(AudioRecorder *recorder, float *data) {
+    if (!data) {
+        return;
+    }
+    if (recorder->n_spares < POOL_SIZE && pool_header(data)->capacity <= POOL_KEEP_SAMPLES) {
+        recorder->spares[recorder->n_spares++] = data;
     } else {
-        // Write to buffer
-        if (recorder->buffer) {
-            // Resize buffer if needed
-            if (recorder->write_position + samples > recorder->buffer_capacity) {
-                size_t new_capacity = recorder->buffer_capacity * 2;
-                if (new_capacity < recorder->write_position + samples) {
-                    new_capacity = recorder->write_position + samples + 16384;
-                }
+        pool_free(data);
+    }
+}
+
+static void convert_s16_to_f32(float *dst, const int16_t *src, size_t count) {
+    size_t i = 0;
+#if defined(AUDIO_USE_SSE2)
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+    for (; i + 8 <= count; i += 8) {
+        __m128i s = _mm_loadu_si128((const __m128i *) (src + i));
+        // Sign-extend by placing each int16 in the high half and shifting back down
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+#elif defined(AUDIO_USE_NEON)
+    const float32x4_t scale = vdupq_n_f32(1.0f / 32768.0f);
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t s = vld1q_s16(src + i);
+        vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))), scale));
+        vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))), scale));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = (float) src[i] / 32768.0f;
+    }
+}
+
+static void release_chunks(AudioRecorder *recorder) {
+    AudioChunk *chunk = recorder->chunks;
+    while (chunk) {
+        AudioChunk *next = chunk->next;
+        if (recorder->n_free_chunks * CHUNK_SAMPLES < POOL_KEEP_SAMPLES) {
+            chunk->next = recorder->free_chunks;
+            recorder->free_chunks = chunk;
+            recorder->n_free_chunks++;
+        } else {
+            free(chunk);
+        }
+        chunk = next;
+    }
+    recorder->chunks = NULL;
+    recorder->chunks_tail = NULL;
+}
+
+// Empty the storage for a new recording
+static void storage_reset(AudioRecorder *recorder) {
+    release_chunks(recorder);
+    recorder->buffer_size = 0;
+
+    // A buffer that grew during a long recording that was never taken goes back too
+    if (recorder->buffer && pool_header(recorder->buffer)->capacity > POOL_KEEP_SAMPLES) {
+        pool_free(recorder->buffer);
+        recorder->buffer = NULL;
+    }
+    if (!recorder->compact && !recorder->buffer) {
+        recorder->buffer = pool_get(recorder, INITIAL_BUFFER_SAMPLES);
+    }
+}
+
+// Append samples to the recording storage, growing it on the consumer thread
+static void buffer_append(AudioRecorder *recorder, const float *samples, size_t count) {
+    if (recorder->samples_callback && count > 0) {
+        recorder->samples_callback(samples, (int) count);
+    }
 
-                float *new_buffer = (float *) realloc(recorder->buffer, new_capacity * sizeof(float));
-                if (new_buffer) {
-                    recorder->buffer = new_buffer;
-                    recorder->buffer_capacity = new_capacity;
+    if (recorder->compact) {
+        while (count > 0) {
+            size_t offset = recorder->buffer_size % CHUNK_SAMPLES;
+            if (offset == 0) {
+                AudioChunk *chunk = recorder->free_chunks;
+                if (chunk) {
+                    recorder->free_chunks = chunk->next;
+                    recorder->n_free_chunks--;
+                } else {
+                    chunk = (AudioChunk *) malloc(sizeof(AudioChunk));
+                    if (!chunk) {
+                        log_error("Failed to allocate audio segment");
+                        return;
+                    }
                 }
+                chunk->next = NULL;
+                if (recorder->chunks_tail) {
+                    recorder->chunks_tail->next = chunk;
+                } else {
+                    recorder->chunks = chunk;
+                }
+                recorder->chunks_tail = chunk;
             }
 
-            // Copy data to buffer
-            if (recorder->write_position + samples <= recorder->buffer_capacity) {
-                memcpy(recorder->buffer + recorder->write_position, input, samples * sizeof(float));
-                recorder->write_position += samples;
-                recorder->buffer_size = recorder->write_position;
+            size_t n = CHUNK_SAMPLES - offset;
+            if (n > count) {
+                n = count;
             }
+            ma_pcm_f32_to_s16(recorder->chunks_tail->samples + offset, samples, n, ma_dither_mode_none);
+            recorder->buffer_size += n;
+            samples += n;
+            count -= n;
         }
+        return;
     }
 
-    recorder->total_frames += frameCount;
+    size_t capacity = recorder->buffer ? pool_header(recorder->buffer)->capacity : 0;
+    if (recorder->buffer_size + count > capacity) {
+        size_t new_capacity = capacity * 2;
+        if (new_capacity < recorder->buffer_size + count) {
+            new_capacity = recorder->buffer_size + count + 16384;
+        }
 
-    (void) pOutput; // Unused
+        BufferHeader *header = recorder->buffer ? pool_header(recorder->buffer) : NULL;
+        BufferHeader *grown = (BufferHeader *) realloc(header, sizeof(BufferHeader) + new_capacity * sizeof(float));
+        if (!grown) {
+            log_error("Failed to grow audio buffer to %zu samples", new_capacity);
+            return;
+        }
+        grown->capacity = new_capacity;
+        recorder->buffer = (float *) (grown + 1);
+    }
+
+    memcpy(recorder->buffer + recorder->buffer_size, samples, count * sizeof(float));
+    recorder->buffer_size += count;
+}
+
+// Copy count samples starting at offset out of the storage as float
+static void storage_read(AudioRecorder *recorder, float *dst, size_t offset, size_t count) {
+    if (!recorder->compact) {
+        memcpy(dst, recorder->buffer + offset, count * sizeof(float));
+        return;
+    }
+
+    AudioChunk *chunk = recorder->chunks;
+    for (size_t skip = offset / CHUNK_SAMPLES; chunk && skip > 0; skip--) {
+        chunk = chunk->next;
+    }
+    size_t chunk_offset = offset % CHUNK_SAMPLES;
+    while (chunk && count > 0) {
+        size_t n = CHUNK_SAMPLES - chunk_offset;
+        if (n > count) {
+            n = count;
+        }
+        convert_s16_to_f32(dst, chunk->samples + chunk_offset, n);
+        dst += n;
+        count -= n;
+        chunk_offset = 0;
+        chunk = chunk->next;
+    }
+}
+
+// Keep the most recent samples while idle in always-on mode
+static void preroll_append(AudioRecorder *recorder, const float *samples, size_t count) {
+    if (recorder->preroll_capacity == 0) {
+        return;
+    }
+
+    // Only the tail can survive if more arrives than the history holds
+    if (count > recorder->preroll_capacity) {
+        samples += count - recorder->preroll_capacity;
+        count = recorder->preroll_capacity;
+    }
+
+    size_t first = recorder->preroll_capacity - recorder->preroll_position;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(recorder->preroll + recorder->preroll_position, samples, first * sizeof(float));
+    memcpy(recorder->preroll, samples + first, (count - first) * sizeof(float));
+
+    recorder->preroll_position = (recorder->preroll_position + count) % recorder->preroll_capacity;
+    recorder->preroll_fill += count;
+    if (recorder->preroll_fill > recorder->preroll_capacity) {
+        recorder->preroll_fill = recorder->preroll_capacity;
+    }
+}
+
+// Move the pre-roll history, oldest sample first, to the start of the recording buffer
+static void preroll_flush_to_buffer(AudioRecorder *recorder) {
+    size_t fill = recorder->preroll_fill;
+    size_t oldest = (recorder->preroll_position + recorder->preroll_capacity - fill) % recorder->preroll_capacity;
+    size_t first = recorder->preroll_capacity - oldest;
+    if (first > fill) {
+        first = fill;
+    }
+
+    buffer_append(recorder, recorder->preroll + oldest, first);
+    buffer_append(recorder, recorder->preroll, fill - first);
+    recorder->preroll_fill = 0;
+}
+
+// Move everything currently published in the ring to its destination.
+// Callers must hold consumer_mutex so there is only one consumer.
+static void drain_ring(AudioRecorder *recorder) {
+    for (;;) {
+        ma_uint32 frames = ma_pcm_rb_available_read(&recorder->ring);
+        if (frames == 0) {
+            break;
+        }
+
+        void *src = NULL;
+        if (ma_pcm_rb_acquire_read(&recorder->ring, &frames, &src) != MA_SUCCESS || frames == 0) {
+            break;
+        }
+
+        if (!utils_atomic_read_bool(&recorder->is_recording)) {
+            preroll_append(recorder, (const float *) src, (size_t) frames * WHISPER_CHANNELS);
+        } else if (utils_atomic_read_bool(&recorder->is_file_recording)) {
+            ma_encoder_write_pcm_frames(&recorder->encoder, src, frames, NULL);
+            utils_atomic_write_int(&recorder->total_frames, recorder->total_frames + (int) frames);
+        } else {
+            buffer_append(recorder, (const float *) src, (size_t) frames * WHISPER_CHANNELS);
+            utils_atomic_write_int(&recorder->total_frames, recorder->total_frames + (int) frames);
+        }
+
+        ma_pcm_rb_commit_read(&recorder->ring, frames);
+    }
+}
+
+static void *drain_thread_main(void *arg) {
+    AudioRecorder *recorder = (AudioRecorder *) arg;
+
+    while (utils_atomic_read_bool(&recorder->drain_running)) {
+        utils_mutex_lock(recorder->consumer_mutex);
+        drain_ring(recorder);
+        utils_mutex_unlock(recorder->consumer_mutex);
+        utils_sleep_ms(DRAIN_INTERVAL_MS);
+    }
+
+    return NULL;
+}
+
+// Reset the ring and start consuming it; called before the device starts
+static bool start_draining(AudioRecorder *recorder) {
+    ma_pcm_rb_reset(&recorder->ring);
+    utils_atomic_write_int(&recorder->dropped_frames, 0);
+
+    utils_atomic_write_bool(&recorder->drain_running, true);
+    recorder->drain_thread = utils_thread_create(drain_thread_main, recorder);
+    if (!recorder->drain_thread) {
+        log_error("Failed to start audio drain thread");
+        utils_atomic_write_bool(&recorder->drain_running, false);
+        return false;
+    }
+    return true;
+}
+
+// Join the drain thread and pick up whatever the audio thread published last;
+// called after the device has stopped
+static void stop_draining(AudioRecorder *recorder) {
+    utils_atomic_write_bool(&recorder->drain_running, false);
+    utils_thread_join(recorder->drain_thread);
+    recorder->drain_thread = NULL;
+
+    utils_mutex_lock(recorder->consumer_mutex);
+    drain_ring(recorder);
+    utils_mutex_unlock(recorder->consumer_mutex);
+}
+
+// Start or stop the device together with the callback gate and drain thread
+static bool start_capture(AudioRecorder *recorder) {
+    if (!start_draining(recorder)) {
+        return false;
+    }
+    utils_atomic_write_bool(&recorder->is_capturing, true);
+
+    if (ma_device_start(&recorder->device) != MA_SUCCESS) {
+        utils_atomic_write_bool(&recorder->is_capturing, false);
+        stop_draining(recorder);
+        return false;
+    }
+    return true;
+}
+
+static void stop_capture(AudioRecorder *recorder) {
+    // No more callbacks after ma_device_stop returns
+    ma_device_stop(&recorder->device);
+    utils_atomic_write_bool(&recorder->is_capturing, false);
+    stop_draining(recorder);
+}
+
+static void log_recording_stats(AudioRecorder *recorder) {
+    int dropped = utils_atomic_read_int(&recorder->dropped_frames);
+    if (dropped > 0) {
+        log_error("Audio capture ring overflowed, dropped %d frames (%.0f ms)", dropped,
+                  dropped * 1000.0 / WHISPER_SAMPLE_RATE);
+    }
+
+    if (!utils_atomic_read_bool(&recorder->first_frame_pending)) {
+        log_info("⏱️  Key press to first captured frame: %.0f ms%s",
+                 (recorder->first_frame_time - recorder->press_time) * 1000.0,
+                 recorder->always_on ? " (pre-roll already buffered)" : "");
+    }
 }
 
 bool audio_recorder_init(void) {
@@ -95,22 +492,38 @@ bool audio_recorder_init(void) {
     deviceConfig.capture.format = ma_format_f32; // Always use float32
     deviceConfig.capture.channels = WHISPER_CHANNELS;
     deviceConfig.sampleRate = WHISPER_SAMPLE_RATE;
+    deviceConfig.performanceProfile = ma_performance_profile_low_latency;
+    deviceConfig.periodSizeInMilliseconds = CAPTURE_PERIOD_MS;
     deviceConfig.dataCallback = data_callback;
     deviceConfig.pUserData = g_recorder;
 
+    // Pre-allocate the capture ring so the audio thread never allocates
+    if (ma_pcm_rb_init(ma_format_f32, WHISPER_CHANNELS, WHISPER_SAMPLE_RATE * CAPTURE_RING_SECONDS, NULL, NULL,
+                       &g_recorder->ring) != MA_SUCCESS) {
+        log_error("Failed to allocate audio capture ring");
+        free(g_recorder);
+        g_recorder = NULL;
+        return false;
+    }
+
+    g_recorder->consumer_mutex = utils_mutex_create();
+
     // Initialize device
     if (ma_device_init(NULL, &deviceConfig, &g_recorder->device) != MA_SUCCESS) {
         log_error("Failed to initialize audio device");
+        ma_pcm_rb_uninit(&g_recorder->ring);
+        utils_mutex_destroy(g_recorder->consumer_mutex);
         free(g_recorder);
         g_recorder = NULL;
         return false;
     }
 
     // Allocate initial buffer for memory recording
-    g_recorder->buffer_capacity = WHISPER_SAMPLE_RATE * WHISPER_CHANNELS * 10; // 10 seconds initial
-    g_recorder->buffer = (float *) malloc(g_recorder->buffer_capacity * sizeof(float));
+    g_recorder->buffer = pool_alloc(INITIAL_BUFFER_SAMPLES);
     if (!g_recorder->buffer) {
         ma_device_uninit(&g_recorder->device);
+        ma_pcm_rb_uninit(&g_recorder->ring);
+        utils_mutex_destroy(g_recorder->consumer_mutex);
         free(g_recorder);
         g_recorder = NULL;
         return false;
@@ -136,13 +549,28 @@ int audio_recorder_start_file(const char *filename) {
 
     // Store filename
     g_recorder->filename = utils_strdup(filename);
+    g_recorder->start_time = 0; // We'll track frames instead of time
+    g_recorder->press_time = utils_get_time();
+    utils_atomic_write_bool(&g_recorder->first_frame_pending, true);
+
+    // Always-on capture is already running, just switch the consumer over to the file
+    if (g_recorder->always_on) {
+        utils_mutex_lock(g_recorder->consumer_mutex);
+        drain_ring(g_recorder);
+        g_recorder->preroll_fill = 0;
+        utils_atomic_write_int(&g_recorder->total_frames, 0);
+        utils_atomic_write_bool(&g_recorder->is_file_recording, true);
+        utils_atomic_write_bool(&g_recorder->is_recording, true);
+        utils_mutex_unlock(g_recorder->consumer_mutex);
+        return 0;
+    }
+
+    utils_atomic_write_int(&g_recorder->total_frames, 0);
     utils_atomic_write_bool(&g_recorder->is_file_recording, true);
     utils_atomic_write_bool(&g_recorder->is_recording, true);
-    g_recorder->start_time = 0; // We'll track frames instead of time
-    g_recorder->total_frames = 0;
 
     // Start device
-    if (ma_device_start(&g_recorder->device) != MA_SUCCESS) {
+    if (!start_capture(g_recorder)) {
         ma_encoder_uninit(&g_recorder->encoder);
         free(g_recorder->filename);
         g_recorder->filename = NULL;
@@ -159,16 +587,38 @@ int audio_recorder_start(void) {
         return -1;
     }
 
+    g_recorder->start_time = 0; // We'll track frames instead of time
+    g_recorder->press_time = utils_get_time();
+    utils_atomic_write_bool(&g_recorder->first_frame_pending, true);
+
+    // Always-on capture: the recording begins with the buffered pre-roll,
+    // so no device start sits between the key press and the first sample
+    if (g_recorder->always_on) {
+        utils_mutex_lock(g_recorder->consumer_mutex);
+        drain_ring(g_recorder);
+        storage_reset(g_recorder);
+        size_t preroll_samples = g_recorder->preroll_fill;
+        preroll_flush_to_buffer(g_recorder);
+        utils_atomic_write_int(&g_recorder->total_frames, (int) (g_recorder->buffer_size / WHISPER_CHANNELS));
+        utils_atomic_write_bool(&g_recorder->is_file_recording, false);
+        utils_atomic_write_bool(&g_recorder->is_recording, true);
+        utils_mutex_unlock(g_recorder->consumer_mutex);
+
+        log_info("⏱️  Recording starts %.0f ms before key press (pre-roll)",
+                 preroll_samples * 1000.0 / (WHISPER_SAMPLE_RATE * WHISPER_CHANNELS));
+        return 0;
+    }
+
     // Reset buffer
-    g_recorder->write_position = 0;
-    g_recorder->buffer_size = 0;
+    utils_mutex_lock(g_recorder->consumer_mutex);
+    storage_reset(g_recorder);
+    utils_mutex_unlock(g_recorder->consumer_mutex);
+    utils_atomic_write_int(&g_recorder->total_frames, 0);
     utils_atomic_write_bool(&g_recorder->is_file_recording, false);
     utils_atomic_write_bool(&g_recorder->is_recording, true);
-    g_recorder->start_time = 0; // We'll track frames instead of time
-    g_recorder->total_frames = 0;
 
     // Start device
-    if (ma_device_start(&g_recorder->device) != MA_SUCCESS) {
+    if (!start_capture(g_recorder)) {
         utils_atomic_write_bool(&g_recorder->is_recording, false);
         return -1;
     }
@@ -181,8 +631,18 @@ int audio_recorder_stop(void) {
         return -1;
     }
 
-    // Stop device
-    ma_device_stop(&g_recorder->device);
+    if (g_recorder->always_on) {
+        // Keep the device running; take what has been published so far
+        // and send everything after it back to the pre-roll history
+        utils_mutex_lock(g_recorder->consumer_mutex);
+        drain_ring(g_recorder);
+        utils_atomic_write_bool(&g_recorder->is_recording, false);
+        utils_mutex_unlock(g_recorder->consumer_mutex);
+    } else {
+        // Flush the ring into the buffer or file before leaving recording state
+        stop_capture(g_recorder);
+        utils_atomic_write_bool(&g_recorder->is_recording, false);
+    }
 
     // Clean up file recording
     if (utils_atomic_read_bool(&g_recorder->is_file_recording)) {
@@ -191,29 +651,158 @@ int audio_recorder_stop(void) {
         g_recorder->filename = NULL;
     }
 
-    utils_atomic_write_bool(&g_recorder->is_recording, false);
     utils_atomic_write_bool(&g_recorder->is_file_recording, false);
 
+    log_recording_stats(g_recorder);
+
+    return 0;
+}
+
+int audio_recorder_set_preroll(int preroll_ms) {
+    if (!g_recorder || utils_atomic_read_bool(&g_recorder->is_recording)) {
+        return -1;
+    }
+
+    // Tear down the current always-on capture first
+    if (g_recorder->always_on) {
+        stop_capture(g_recorder);
+        g_recorder->always_on = false;
+    }
+
+    free(g_recorder->preroll);
+    g_recorder->preroll = NULL;
+    g_recorder->preroll_capacity = 0;
+    g_recorder->preroll_position = 0;
+    g_recorder->preroll_fill = 0;
+
+    if (preroll_ms <= 0) {
+        log_info("🎙️ Always-on capture disabled");
+        return 0;
+    }
+
+    g_recorder->preroll_capacity = (size_t) WHISPER_SAMPLE_RATE * WHISPER_CHANNELS * preroll_ms / 1000;
+    g_recorder->preroll = (float *) malloc(g_recorder->preroll_capacity * sizeof(float));
+    if (!g_recorder->preroll) {
+        g_recorder->preroll_capacity = 0;
+        return -1;
+    }
+
+    if (!start_capture(g_recorder)) {
+        log_error("Failed to start always-on audio capture");
+        free(g_recorder->preroll);
+        g_recorder->preroll = NULL;
+        g_recorder->preroll_capacity = 0;
+        return -1;
+    }
+
+    g_recorder->always_on = true;
+    log_info("🎙️ Always-on capture enabled with %d ms pre-roll", preroll_ms);
     return 0;
 }
 
 float *audio_recorder_get_samples(int *out_sample_count) {
+    return audio_recorder_copy_samples(0, out_sample_count);
+}
+
+float *audio_recorder_copy_samples(int offset, int *out_sample_count) {
+    if (!g_recorder || !out_sample_count || offset < 0) {
+        return NULL;
+    }
+
+    *out_sample_count = 0;
+    float *copy = NULL;
+
+    // The consumer side may be appending (and reallocating) concurrently
+    utils_mutex_lock(g_recorder->consumer_mutex);
+    if (g_recorder->buffer_size > (size_t) offset) {
+        size_t count = g_recorder->buffer_size - (size_t) offset;
+        copy = (float *) malloc(count * sizeof(float));
+        if (copy) {
+            storage_read(g_recorder, copy, (size_t) offset, count);
+            *out_sample_count = (int) count;
+        }
+    }
+    utils_mutex_unlock(g_recorder->consumer_mutex);
+
+    return copy;
+}
+
+float *audio_recorder_take_samples(int *out_sample_count) {
     if (!g_recorder || !out_sample_count) {
         return NULL;
     }
 
-    *out_sample_count = (int) g_recorder->buffer_size;
+    *out_sample_count = 0;
+    float *samples = NULL;
 
-    // Create a copy of the buffer for the caller
+    utils_mutex_lock(g_recorder->consumer_mutex);
     if (g_recorder->buffer_size > 0) {
-        float *copy = (float *) malloc(g_recorder->buffer_size * sizeof(float));
-        if (copy) {
-            memcpy(copy, g_recorder->buffer, g_recorder->buffer_size * sizeof(float));
+        if (g_recorder->compact) {
+            // The one conversion pass replaces the copy float mode avoids
+            samples = pool_get(g_recorder, g_recorder->buffer_size);
+            if (samples) {
+                storage_read(g_recorder, samples, 0, g_recorder->buffer_size);
+            }
+        } else {
+            // Hand the filled buffer over and record into a spare from now on
+            samples = g_recorder->buffer;
+            g_recorder->buffer = NULL;
         }
-        return copy;
+
+        if (samples) {
+            *out_sample_count = (int) g_recorder->buffer_size;
+        }
+        storage_reset(g_recorder);
     }
+    utils_mutex_unlock(g_recorder->consumer_mutex);
 
-    return NULL;
+    return samples;
+}
+
+void audio_recorder_release_samples(float *samples) {
+    if (!samples) {
+        return;
+    }
+    if (!g_recorder) {
+        pool_free(samples);
+        return;
+    }
+
+    utils_mutex_lock(g_recorder->consumer_mutex);
+    pool_put(g_recorder, samples);
+    utils_mutex_unlock(g_recorder->consumer_mutex);
+}
+
+int audio_recorder_set_compact_storage(bool compact) {
+    if (!g_recorder || utils_atomic_read_bool(&g_recorder->is_recording)) {
+        return -1;
+    }
+
+    utils_mutex_lock(g_recorder->consumer_mutex);
+    if (g_recorder->compact != compact) {
+        release_chunks(g_recorder);
+        g_recorder->buffer_size = 0;
+        if (compact) {
+            pool_put(g_recorder, g_recorder->buffer);
+            g_recorder->buffer = NULL;
+        }
+        g_recorder->compact = compact;
+        storage_reset(g_recorder);
+        log_info("🎙️ Audio storage: %s", compact ? "compact int16 segments" : "float buffer");
+    }
+    utils_mutex_unlock(g_recorder->consumer_mutex);
+
+    return 0;
+}
+
+void audio_recorder_set_samples_callback(audio_samples_callback callback) {
+    if (!g_recorder) {
+        return;
+    }
+
+    utils_mutex_lock(g_recorder->consumer_mutex);
+    g_recorder->samples_callback = callback;
+    utils_mutex_unlock(g_recorder->consumer_mutex);
 }
 
 double audio_recorder_get_duration(void) {
@@ -221,7 +810,7 @@ double audio_recorder_get_duration(void) {
         return 0.0;
     }
 
-    return (double) g_recorder->total_frames / (double) WHISPER_SAMPLE_RATE;
+    return (double) utils_atomic_read_int(&g_recorder->total_frames) / (double) WHISPER_SAMPLE_RATE;
 }
 
 bool audio_recorder_is_recording(void) {
@@ -238,9 +827,25 @@ void audio_recorder_cleanup(void) {
         audio_recorder_stop();
     }
 
+    if (g_recorder->always_on) {
+        stop_capture(g_recorder);
+    }
+
     // Clean up
     ma_device_uninit(&g_recorder->device);
-    free(g_recorder->buffer);
+    ma_pcm_rb_uninit(&g_recorder->ring);
+    utils_mutex_destroy(g_recorder->consumer_mutex);
+    free(g_recorder->preroll);
+    pool_free(g_recorder->buffer);
+    for (int i = 0; i < g_recorder->n_spares; i++) {
+        pool_free(g_recorder->spares[i]);
+    }
+    release_chunks(g_recorder);
+    while (g_recorder->free_chunks) {
+        AudioChunk *next = g_recorder->free_chunks->next;
+        free(g_recorder->free_chunks);
+        g_recorder->free_chunks = next;
+    }
     free(g_recorder->filename);
     free(g_recorder);
     g_recorder = NULL;
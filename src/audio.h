@@ -24,11 +24,41 @@ int audio_recorder_start_file(const char *filename);
 // Returns 0 on success, -1 on failure
 int audio_recorder_stop(void);
 
+// Keep the capture device running between recordings and buffer the last
+// preroll_ms of audio, so audio_recorder_start() begins that far in the past.
+// Pass 0 to go back to starting the device on demand.
+// Returns 0 on success, -1 on failure
+int audio_recorder_set_preroll(int preroll_ms);
+
 // Get the recorded audio samples
 // Returns pointer to audio data, count is written to out_sample_count
 // Caller must free the returned buffer
 float *audio_recorder_get_samples(int *out_sample_count);
 
+// Take ownership of the recorded audio without copying it. The recorder
+// switches to a spare buffer, so the next recording can start immediately.
+// Returns pointer to audio data, count is written to out_sample_count
+// Caller must return the buffer with audio_recorder_release_samples()
+float *audio_recorder_take_samples(int *out_sample_count);
+
+// Give a buffer from audio_recorder_take_samples() back to the recorder's pool
+void audio_recorder_release_samples(float *samples);
+
+// Store recordings as int16 segments (half the memory, converted to float on
+// take) instead of a contiguous float buffer. Only allowed while not recording.
+// Returns 0 on success, -1 on failure
+int audio_recorder_set_compact_storage(bool compact);
+
+// Copy the samples recorded so far, starting at offset, while recording continues
+// Returns pointer to audio data, count is written to out_sample_count
+// Caller must free the returned buffer
+float *audio_recorder_copy_samples(int offset, int *out_sample_count);
+
+// Receive every sample appended to a memory recording (including pre-roll), in order.
+// Called on the drain thread, never on the real-time audio thread. Pass NULL to remove.
+typedef void (*audio_samples_callback)(const float *samples, int n_samples);
+void audio_recorder_set_samples_callback(audio_samples_callback callback);
+
 // Get recording duration in seconds
 double audio_recorder_get_duration(void);
 
@@ -0,0 +1,537 @@
+#include "audio_input.h"
+#include "logging.h"
+#include "miniaudio.h"
+#include "utils.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AUDIO_USE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AUDIO_USE_NEON
+#endif
+
+#define WHISPER_SAMPLE_RATE 16000
+
+// Source frames converted per step; bounds memory regardless of file length
+#define CHUNK_FRAMES 4096
+
+// Windowed-sinc resampler: taps per output sample and precomputed
+// fractional-delay phases
+#define RESAMPLE_TAPS 32
+#define RESAMPLE_HALF (RESAMPLE_TAPS / 2)
+#define RESAMPLE_PHASES 256
+
+typedef enum {
+    SOURCE_WAV_U8,
+    SOURCE_WAV_S16,
+    SOURCE_WAV_S24,
+    SOURCE_WAV_S32,
+    SOURCE_WAV_F32,
+    SOURCE_DECODER, // miniaudio, already float
+} SourceFormat;
+
+struct AudioInput {
+    SourceFormat format;
+    int channels;
+    int sample_rate;
+    long long n_frames; // Source frames, 0 if unknown
+
+    // Memory-mapped WAV
+    const void *map;
+    size_t map_size;
+    const unsigned char *pcm;
+    long long frame_pos;
+
+    // Everything else
+    ma_decoder decoder;
+    float *interleaved;
+
+    // Mono source samples in [buf_start, buf_start + buf_len)
+    float *buf;
+    long long buf_start;
+    int buf_len;
+    bool source_done;
+
+    // Resampling; output sample n sits at source position n * in / out
+    float *kernels; // RESAMPLE_PHASES + 1 kernels of RESAMPLE_TAPS
+    long long out_pos;
+};
+
+// ---------------------------------------------------------------------------
+// Conversion kernels: interleaved source frames to mono float
+
+static void s16_to_mono(float *dst, const int16_t *src, int frames, int channels) {
+    int i = 0;
+    if (channels == 1) {
+#if defined(AUDIO_USE_SSE2)
+        const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+        for (; i + 8 <= frames; i += 8) {
+            __m128i s = _mm_loadu_si128((const __m128i *) (src + i));
+            __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+            __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+            _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+        }
+#elif defined(AUDIO_USE_NEON)
+        const float32x4_t scale = vdupq_n_f32(1.0f / 32768.0f);
+        for (; i + 8 <= frames; i += 8) {
+            int16x8_t s = vld1q_s16(src + i);
+            vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))), scale));
+            vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))), scale));
+        }
+#endif
+    } else if (channels == 2) {
+#if defined(AUDIO_USE_SSE2)
+        // madd sums each left/right pair into one int32
+        const __m128i ones = _mm_set1_epi16(1);
+        const __m128 scale = _mm_set1_ps(1.0f / 65536.0f);
+        for (; i + 4 <= frames; i += 4) {
+            __m128i s = _mm_loadu_si128((const __m128i *) (src + 2 * i));
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_madd_epi16(s, ones)), scale));
+        }
+#elif defined(AUDIO_USE_NEON)
+        const float32x4_t scale = vdupq_n_f32(1.0f / 65536.0f);
+        for (; i + 4 <= frames; i += 4) {
+            int16x8_t s = vld1q_s16(src + 2 * i);
+            vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vpaddlq_s16(s)), scale));
+        }
+#endif
+    }
+
+    const float scale = 1.0f / (32768.0f * channels);
+    for (; i < frames; i++) {
+        int sum = 0;
+        for (int ch = 0; ch < channels; ch++) {
+            sum += src[i * channels + ch];
+        }
+        dst[i] = (float) sum * scale;
+    }
+}
+
+static void f32_to_mono(float *dst, const float *src, int frames, int channels) {
+    int i = 0;
+    if (channels == 1) {
+        memcpy(dst, src, (size_t) frames * sizeof(float));
+        return;
+    }
+    if (channels == 2) {
+#if defined(AUDIO_USE_SSE2)
+        const __m128 half = _mm_set1_ps(0.5f);
+        for (; i + 4 <= frames; i += 4) {
+            __m128 a = _mm_loadu_ps(src + 2 * i);
+            __m128 b = _mm_loadu_ps(src + 2 * i + 4);
+            __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_add_ps(left, right), half));
+        }
+#elif defined(AUDIO_USE_NEON)
+        for (; i + 4 <= frames; i += 4) {
+            float32x4x2_t s = vld2q_f32(src + 2 * i);
+            vst1q_f32(dst + i, vmulq_n_f32(vaddq_f32(s.val[0], s.val[1]), 0.5f));
+        }
+#endif
+    }
+
+    const float scale = 1.0f / channels;
+    for (; i < frames; i++) {
+        float sum = 0.0f;
+        for (int ch = 0; ch < channels; ch++) {
+            sum += src[i * channels + ch];
+        }
+        dst[i] = sum * scale;
+    }
+}
+
+// WAV data is little-endian
+static void other_to_mono(float *dst, const unsigned char *src, int frames, int channels, SourceFormat format) {
+    const int bytes = format == SOURCE_WAV_U8 ? 1 : (format == SOURCE_WAV_S24 ? 3 : 4);
+    const float scale = 1.0f / channels;
+    for (int i = 0; i < frames; i++) {
+        float sum = 0.0f;
+        for (int ch = 0; ch < channels; ch++) {
+            const unsigned char *p = src + ((size_t) i * channels + ch) * bytes;
+            if (format == SOURCE_WAV_U8) {
+                sum += ((float) p[0] - 128.0f) / 128.0f;
+            } else if (format == SOURCE_WAV_S24) {
+                int32_t v = (int32_t) ((uint32_t) p[0] << 8 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 24);
+                sum += (float) (v >> 8) / 8388608.0f;
+            } else {
+                int32_t v = (int32_t) ((uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 |
+                                       (uint32_t) p[3] << 24);
+                sum += (float) v / 2147483648.0f;
+            }
+        }
+        dst[i] = sum * scale;
+    }
+}
+
+static int bytes_per_sample(SourceFormat format) {
+    switch (format) {
+        case SOURCE_WAV_U8: return 1;
+        case SOURCE_WAV_S16: return 2;
+        case SOURCE_WAV_S24: return 3;
+        default: return 4;
+    }
+}
+
+// Convert up to max_frames source frames to mono; returns the number converted
+static int read_source(AudioInput *input, float *dst, int max_frames) {
+    if (input->format == SOURCE_DECODER) {
+        ma_uint64 frames = 0;
+        ma_decoder_read_pcm_frames(&input->decoder, input->interleaved, (ma_uint64) max_frames, &frames);
+        f32_to_mono(dst, input->interleaved, (int) frames, input->channels);
+        return (int) frames;
+    }
+
+    long long left = input->n_frames - input->frame_pos;
+    int frames = left < max_frames ? (int) left : max_frames;
+    if (frames <= 0) {
+        return 0;
+    }
+
+    const size_t frame_bytes = (size_t) bytes_per_sample(input->format) * input->channels;
+    const unsigned char *src = input->pcm + (size_t) input->frame_pos * frame_bytes;
+    if (input->format == SOURCE_WAV_S16) {
+        // Fine even if unaligned on the platforms we build for
+        s16_to_mono(dst, (const int16_t *) src, frames, input->channels);
+    } else if (input->format == SOURCE_WAV_F32) {
+        f32_to_mono(dst, (const float *) src, frames, input->channels);
+    } else {
+        other_to_mono(dst, src, frames, input->channels, input->format);
+    }
+    input->frame_pos += frames;
+    return frames;
+}
+
+// ---------------------------------------------------------------------------
+// Resampling
+
+static float dot(const float *a, const float *b) {
+    int i = 0;
+    float sum = 0.0f;
+#if defined(AUDIO_USE_SSE2)
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= RESAMPLE_TAPS; i += 4) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(AUDIO_USE_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= RESAMPLE_TAPS; i += 4) {
+        acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+    float lanes[4];
+    vst1q_f32(lanes, acc);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < RESAMPLE_TAPS; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// Blackman-windowed sinc low-pass kernels, one per fractional delay, cut off
+// below the lower of the two Nyquist rates so downsampling doesn't alias
+static float *make_kernels(int in_rate, int out_rate) {
+    float *kernels = (float *) malloc((size_t) (RESAMPLE_PHASES + 1) * RESAMPLE_TAPS * sizeof(float));
+    if (!kernels) {
+        return NULL;
+    }
+
+    const double pi = 3.14159265358979323846;
+    const double cutoff = 0.95 * (in_rate < out_rate ? 1.0 : (double) out_rate / in_rate);
+    for (int phase = 0; phase <= RESAMPLE_PHASES; phase++) {
+        float *kernel = kernels + phase * RESAMPLE_TAPS;
+        double frac = (double) phase / RESAMPLE_PHASES;
+        double sum = 0.0;
+        for (int k = 0; k < RESAMPLE_TAPS; k++) {
+            // Tap k holds source sample floor(pos) - HALF + 1 + k
+            double x = (double) (k - RESAMPLE_HALF + 1) - frac;
+            double sinc = x == 0.0 ? 1.0 : sin(pi * cutoff * x) / (pi * cutoff * x);
+            double w = (x + RESAMPLE_HALF) / RESAMPLE_TAPS;
+            double window = w <= 0.0 || w >= 1.0 ? 0.0 : 0.42 - 0.5 * cos(2 * pi * w) + 0.08 * cos(4 * pi * w);
+            kernel[k] = (float) (sinc * window);
+            sum += kernel[k];
+        }
+        for (int k = 0; k < RESAMPLE_TAPS; k++) {
+            kernel[k] = (float) (kernel[k] / sum); // Unity gain at DC
+        }
+    }
+    return kernels;
+}
+
+// Make sure buf holds source samples up to index last (or the end of the
+// source), dropping samples before first that are no longer needed
+static void fill_buffer(AudioInput *input, long long first, long long last) {
+    while (!input->source_done && input->buf_start + input->buf_len <= last) {
+        long long drop = first - input->buf_start;
+        if (drop > input->buf_len) drop = input->buf_len;
+        if (drop > 0) {
+            memmove(input->buf, input->buf + drop, (size_t) (input->buf_len - drop) * sizeof(float));
+            input->buf_start += drop;
+            input->buf_len -= (int) drop;
+        }
+
+        int frames = read_source(input, input->buf + input->buf_len, CHUNK_FRAMES);
+        if (frames == 0) {
+            input->source_done = true;
+        }
+        input->buf_len += frames;
+    }
+}
+
+int audio_input_read(AudioInput *input, float *out, int max_samples) {
+    if (!input || !out || max_samples <= 0) {
+        return 0;
+    }
+
+    const long long in_rate = input->sample_rate;
+    const long long out_rate = WHISPER_SAMPLE_RATE;
+    int n = 0;
+
+    if (in_rate == out_rate) {
+        // Straight copy through the buffer
+        while (n < max_samples) {
+            fill_buffer(input, input->out_pos, input->out_pos);
+            long long available = input->buf_start + input->buf_len - input->out_pos;
+            if (available <= 0) {
+                break;
+            }
+            int count = available < max_samples - n ? (int) available : max_samples - n;
+            memcpy(out + n, input->buf + (input->out_pos - input->buf_start), (size_t) count * sizeof(float));
+            input->out_pos += count;
+            n += count;
+        }
+        return n;
+    }
+
+    float window[RESAMPLE_TAPS];
+    while (n < max_samples) {
+        long long scaled = input->out_pos * in_rate;
+        long long pos = scaled / out_rate;
+        int phase = (int) ((scaled % out_rate) * RESAMPLE_PHASES / out_rate);
+        long long first = pos - RESAMPLE_HALF + 1;
+        long long last = pos + RESAMPLE_HALF;
+
+        fill_buffer(input, first, last);
+        long long end = input->buf_start + input->buf_len;
+        if (input->source_done && pos >= end) {
+            break;
+        }
+
+        const float *taps;
+        if (first >= input->buf_start && last < end) {
+            taps = input->buf + (first - input->buf_start);
+        } else {
+            // Beyond either end of the source counts as silence
+            for (int k = 0; k < RESAMPLE_TAPS; k++) {
+                long long index = first + k;
+                window[k] = index >= input->buf_start && index < end ? input->buf[index - input->buf_start] : 0.0f;
+            }
+            taps = window;
+        }
+
+        out[n++] = dot(taps, input->kernels + phase * RESAMPLE_TAPS);
+        input->out_pos++;
+    }
+    return n;
+}
+
+// ---------------------------------------------------------------------------
+// Opening
+
+static uint16_t read_u16(const unsigned char *p) {
+    return (uint16_t) (p[0] | p[1] << 8);
+}
+
+static uint32_t read_u32(const unsigned char *p) {
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+// Parse a mapped RIFF/WAVE file; false if it isn't one we can read directly
+static bool open_wav(AudioInput *input) {
+    const unsigned char *data = (const unsigned char *) input->map;
+    const size_t size = input->map_size;
+    if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    uint16_t format_tag = 0;
+    uint16_t bits = 0;
+    bool have_fmt = false;
+    size_t offset = 12;
+    while (offset + 8 <= size) {
+        const unsigned char *chunk = data + offset;
+        size_t chunk_size = read_u32(chunk + 4);
+        size_t body = offset + 8;
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16 && body + 16 <= size) {
+            format_tag = read_u16(chunk + 8);
+            input->channels = read_u16(chunk + 10);
+            input->sample_rate = (int) read_u32(chunk + 12);
+            bits = read_u16(chunk + 22);
+            if (format_tag == 0xFFFE && chunk_size >= 40 && body + 40 <= size) {
+                format_tag = read_u16(chunk + 32); // WAVE_FORMAT_EXTENSIBLE sub-format
+            }
+            have_fmt = true;
+        } else if (memcmp(chunk, "data", 4) == 0 && have_fmt) {
+            // Streaming writers leave the size at 0 or 0xFFFFFFFF
+            if (chunk_size == 0 || chunk_size == 0xFFFFFFFFu || body + chunk_size > size) {
+                chunk_size = size - body;
+            }
+
+            if (format_tag == 1 && bits == 8) input->format = SOURCE_WAV_U8;
+            else if (format_tag == 1 && bits == 16) input->format = SOURCE_WAV_S16;
+            else if (format_tag == 1 && bits == 24) input->format = SOURCE_WAV_S24;
+            else if (format_tag == 1 && bits == 32) input->format = SOURCE_WAV_S32;
+            else if (format_tag == 3 && bits == 32) input->format = SOURCE_WAV_F32;
+            else return false; // Let miniaudio try (ADPCM, 64-bit float, ...)
+
+            if (input->channels < 1 || input->sample_rate < 1) {
+                return false;
+            }
+            input->pcm = data + body;
+            input->n_frames = (long long) (chunk_size / ((size_t) bytes_per_sample(input->format) * input->channels));
+            return true;
+        }
+
+        offset = body + chunk_size + (chunk_size & 1); // Chunks are word-aligned
+    }
+    return false;
+}
+
+static bool open_decoder(AudioInput *input, const char *path) {
+    // Native rate and channels; conversion happens here like for WAV
+    ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 0, 0);
+    if (ma_decoder_init_file(path, &config, &input->decoder) != MA_SUCCESS) {
+        return false;
+    }
+
+    input->format = SOURCE_DECODER;
+    input->channels = (int) input->decoder.outputChannels;
+    input->sample_rate = (int) input->decoder.outputSampleRate;
+
+    ma_uint64 frames = 0;
+    if (ma_decoder_get_length_in_pcm_frames(&input->decoder, &frames) == MA_SUCCESS) {
+        input->n_frames = (long long) frames;
+    }
+
+    input->interleaved = (float *) malloc((size_t) CHUNK_FRAMES * input->channels * sizeof(float));
+    if (!input->interleaved || input->channels < 1 || input->sample_rate < 1) {
+        ma_decoder_uninit(&input->decoder);
+        return false;
+    }
+    return true;
+}
+
+AudioInput *audio_input_open(const char *path) {
+    if (!path) {
+        return NULL;
+    }
+
+    AudioInput *input = (AudioInput *) calloc(1, sizeof(AudioInput));
+    if (!input) {
+        return NULL;
+    }
+
+    input->map = utils_map_file(path, &input->map_size);
+    if (!input->map || !open_wav(input)) {
+        utils_unmap_file(input->map, input->map_size);
+        input->map = NULL;
+        if (!open_decoder(input, path)) {
+            log_error("ERROR: Could not read audio file: %s", path);
+            free(input->interleaved);
+            free(input);
+            return NULL;
+        }
+    }
+
+    // Room for one chunk beyond what the resampler window still needs
+    input->buf = (float *) malloc((size_t) (CHUNK_FRAMES + RESAMPLE_TAPS) * sizeof(float));
+    if (input->sample_rate != WHISPER_SAMPLE_RATE) {
+        input->kernels = make_kernels(input->sample_rate, WHISPER_SAMPLE_RATE);
+    }
+    if (!input->buf || (input->sample_rate != WHISPER_SAMPLE_RATE && !input->kernels)) {
+        audio_input_close(input);
+        return NULL;
+    }
+
+    log_info("🎵 Audio: %s, %d Hz, %d channels%s", path, input->sample_rate, input->channels,
+             input->map ? " (mapped WAV)" : "");
+    return input;
+}
+
+void audio_input_close(AudioInput *input) {
+    if (!input) {
+        return;
+    }
+    if (input->map) {
+        utils_unmap_file(input->map, input->map_size);
+    } else {
+        ma_decoder_uninit(&input->decoder);
+    }
+    free(input->interleaved);
+    free(input->buf);
+    free(input->kernels);
+    free(input);
+}
+
+int audio_input_source_rate(const AudioInput *input) {
+    return input ? input->sample_rate : 0;
+}
+
+int audio_input_source_channels(const AudioInput *input) {
+    return input ? input->channels : 0;
+}
+
+long long audio_input_length(const AudioInput *input) {
+    if (!input || input->n_frames <= 0) {
+        return 0;
+    }
+    return (input->n_frames * WHISPER_SAMPLE_RATE + input->sample_rate - 1) / input->sample_rate;
+}
+
+float *audio_input_read_file(const char *path, int *n_samples) {
+    AudioInput *input = audio_input_open(path);
+    if (!input) {
+        return NULL;
+    }
+
+    long long expected = audio_input_length(input);
+    int capacity = expected > 0 ? (int) expected + 1 : WHISPER_SAMPLE_RATE * 30;
+    float *samples = (float *) malloc((size_t) capacity * sizeof(float));
+    *n_samples = 0;
+
+    while (samples) {
+        if (*n_samples == capacity) {
+            capacity *= 2;
+            float *grown = (float *) realloc(samples, (size_t) capacity * sizeof(float));
+            if (!grown) {
+                free(samples);
+                samples = NULL;
+                break;
+            }
+            samples = grown;
+        }
+        int n = audio_input_read(input, samples + *n_samples, capacity - *n_samples);
+        if (n == 0) {
+            break;
+        }
+        *n_samples += n;
+    }
+    audio_input_close(input);
+
+    if (samples && *n_samples == 0) {
+        log_error("ERROR: No audio data found in file: %s", path);
+        free(samples);
+        return NULL;
+    }
+    return samples;
+}
@@ -0,0 +1,35 @@
+#ifndef AUDIO_INPUT_H
+#define AUDIO_INPUT_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Audio file input - reads WAV (memory-mapped, PCM 8/16/24/32-bit or float),
+// FLAC and MP3 and delivers 16 kHz mono float in bounded chunks, whatever the
+// source sample rate and channel count.
+typedef struct AudioInput AudioInput;
+
+// Returns NULL if the file can't be opened or decoded
+AudioInput *audio_input_open(const char *path);
+void audio_input_close(AudioInput *input);
+
+int audio_input_source_rate(const AudioInput *input);
+int audio_input_source_channels(const AudioInput *input);
+// Expected number of 16 kHz samples, or 0 if the source doesn't say
+long long audio_input_length(const AudioInput *input);
+
+// Read up to max_samples 16 kHz mono samples.
+// Returns the number read, 0 at the end of the file.
+int audio_input_read(AudioInput *input, float *out, int max_samples);
+
+// Read a whole file. Returns malloc'd samples (free with free()), or NULL.
+float *audio_input_read_file(const char *path, int *n_samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_INPUT_H
@@ -0,0 +1,237 @@
+#include "batch.h"
+#include "audio_input.h"
+#include "preferences.h"
+#include "transcript_output.h"
+#include "transcription.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLE_RATE 16000
+#define MAX_LINE_LENGTH 4096
+#define MAX_JOBS 64
+
+typedef struct {
+    char **paths;
+    int n_paths;
+    int capacity;
+} FileList;
+
+typedef struct {
+    const FileList *files;
+    TranscriptionEngine *engine;
+    FILE *out;
+    utils_mutex_t *mutex; // Guards next, out and the totals
+    int next;
+    int n_failed;
+    double audio_seconds;
+} BatchState;
+
+typedef struct {
+    BatchState *state;
+    int index;
+} BatchWorker;
+
+static void add_file(FileList *list, const char *path) {
+    if (list->n_paths == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 64;
+        char **grown = (char **) realloc(list->paths, (size_t) capacity * sizeof(char *));
+        if (!grown) {
+            return;
+        }
+        list->paths = grown;
+        list->capacity = capacity;
+    }
+    list->paths[list->n_paths++] = utils_strdup(path);
+}
+
+static void add_audio_file(const char *path, void *user_data) {
+    static const char *extensions[] = {".wav", ".flac", ".mp3"};
+    const char *dot = strrchr(path, '.');
+    for (size_t i = 0; dot && i < sizeof(extensions) / sizeof(extensions[0]); i++) {
+        if (utils_stricmp(dot, extensions[i]) == 0) {
+            add_file((FileList *) user_data, path);
+            return;
+        }
+    }
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+// A directory's audio files in name order, or the paths listed in a text file
+static bool collect_files(const char *input, FileList *list) {
+    if (utils_list_dir(input, add_audio_file, list)) {
+        qsort(list->paths, list->n_paths, sizeof(char *), compare_paths);
+        return true;
+    }
+
+    FILE *file = utils_fopen_read(input);
+    if (!file) {
+        return false;
+    }
+    char line[MAX_LINE_LENGTH];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] != '\0' && line[0] != '#') {
+            add_file(list, line);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static void *batch_worker(void *arg) {
+    BatchWorker *worker = (BatchWorker *) arg;
+    BatchState *state = worker->state;
+
+    for (;;) {
+        utils_mutex_lock(state->mutex);
+        int index = state->next < state->files->n_paths ? state->next++ : -1;
+        utils_mutex_unlock(state->mutex);
+        if (index < 0) {
+            break;
+        }
+        const char *path = state->files->paths[index];
+
+        double start = utils_now();
+        int n_samples = 0;
+        float *samples = audio_input_read_file(path, &n_samples);
+        double decoded = utils_now();
+        char *text = samples ? transcription_engine_process(state->engine, samples, n_samples) : NULL;
+        double done = utils_now();
+        bool read_ok = samples != NULL;
+        free(samples);
+
+        double audio_seconds = (double) n_samples / SAMPLE_RATE;
+        double transcribe_ms = (done - decoded) * 1000.0;
+
+        utils_mutex_lock(state->mutex);
+        fprintf(state->out, "{\"path\": ");
+        transcript_json_string(state->out, path);
+        if (text) {
+            fprintf(state->out, ", \"text\": ");
+            transcript_json_string(state->out, text);
+            fprintf(state->out, ", \"audio_s\": %.3f, \"decode_ms\": %.1f, \"transcribe_ms\": %.1f, \"rtf\": %.4f, "
+                                "\"job\": %d}\n",
+                    audio_seconds, (decoded - start) * 1000.0, transcribe_ms,
+                    audio_seconds > 0.0 ? transcribe_ms / 1000.0 / audio_seconds : 0.0, worker->index);
+            state->audio_seconds += audio_seconds;
+        } else {
+            fprintf(state->out, ", \"error\": \"%s\", \"job\": %d}\n",
+                    read_ok ? "transcription failed" : "could not read audio", worker->index);
+            state->n_failed++;
+        }
+        fflush(state->out);
+        printf("[%d/%d] %s: %s (%.0f ms)\n", index + 1, state->files->n_paths, path, text ? "done" : "FAILED",
+               (done - start) * 1000.0);
+        utils_mutex_unlock(state->mutex);
+
+        free(text);
+    }
+    return NULL;
+}
+
+int batch_run(const BatchOptions *options) {
+    FileList files = {0};
+    if (!collect_files(options->input, &files)) {
+        printf("Error: Could not read %s\n", options->input);
+        return 1;
+    }
+    if (files.n_paths == 0) {
+        printf("Error: No audio files in %s\n", options->input);
+        free(files.paths);
+        return 1;
+    }
+
+    int jobs = options->jobs < 1 ? 1 : (options->jobs > MAX_JOBS ? MAX_JOBS : options->jobs);
+    if (jobs > files.n_paths) {
+        jobs = files.n_paths;
+    }
+
+    // One decoder state per job, all sharing the model weights. Not saved.
+    preferences_set_int("transcription_states", jobs);
+    double load_start = utils_now();
+    int result = transcription_init(options->model_path);
+    double load_ms = (utils_now() - load_start) * 1000.0;
+    TranscriptionEngine *engine = result == 0 ? transcription_get_engine() : NULL;
+    if (!engine) {
+        printf("Error: Failed to initialize transcription\n");
+        for (int i = 0; i < files.n_paths; i++) free(files.paths[i]);
+        free(files.paths);
+        return 1;
+    }
+    transcription_set_language(options->language ? options->language : "auto");
+    jobs = transcription_engine_n_states(engine); // Fewer if memory ran out
+    // The jobs share the engine's thread budget
+    if (options->threads_per_job > 0) {
+        transcription_engine_set_threads(engine, options->threads_per_job * jobs);
+    }
+    int threads = transcription_engine_get_threads(engine) / jobs;
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    FILE *out = utils_fopen_write(options->output_path);
+    if (!out) {
+        printf("Error: Could not write %s\n", options->output_path);
+        transcription_cleanup();
+        for (int i = 0; i < files.n_paths; i++) free(files.paths[i]);
+        free(files.paths);
+        return 1;
+    }
+
+    printf("=== Batch: %d files, %d jobs x %d threads (model loaded in %.0f ms) ===\n", files.n_paths, jobs, threads,
+           load_ms);
+
+    BatchState state = {0};
+    state.files = &files;
+    state.engine = engine;
+    state.out = out;
+    state.mutex = utils_mutex_create();
+
+    double start = utils_now();
+    BatchWorker workers[MAX_JOBS];
+    utils_thread_t *handles[MAX_JOBS];
+    int n_started = 0;
+    for (int i = 0; i < jobs; i++) {
+        workers[i].state = &state;
+        workers[i].index = i;
+        handles[i] = utils_thread_create(batch_worker, &workers[i]);
+        if (handles[i]) {
+            n_started++;
+        }
+    }
+    if (n_started == 0) {
+        batch_worker(&workers[0]); // No threads; do it all here
+    }
+    for (int i = 0; i < jobs; i++) {
+        if (handles[i]) {
+            utils_thread_join(handles[i]);
+        }
+    }
+    double wall_seconds = utils_now() - start;
+
+    // Audio-hours per wall-hour is the same ratio as audio-seconds per wall-second
+    double throughput = wall_seconds > 0.0 ? state.audio_seconds / wall_seconds : 0.0;
+    fprintf(out, "{\"summary\": {\"files\": %d, \"failed\": %d, \"jobs\": %d, \"threads_per_job\": %d, "
+                 "\"model_load_ms\": %.1f, \"audio_hours\": %.4f, \"wall_hours\": %.4f, "
+                 "\"audio_hours_per_wall_hour\": %.2f}}\n",
+            files.n_paths, state.n_failed, jobs, threads, load_ms, state.audio_seconds / 3600.0,
+            wall_seconds / 3600.0, throughput);
+    fclose(out);
+
+    printf("\n=== %d/%d files, %.2f h of audio in %.2f min: %.1f audio-hours per wall-hour ===\n",
+           files.n_paths - state.n_failed, files.n_paths, state.audio_seconds / 3600.0, wall_seconds / 60.0,
+           throughput);
+    printf("Results written to %s\n", options->output_path);
+
+    utils_mutex_destroy(state.mutex);
+    transcription_cleanup();
+    for (int i = 0; i < files.n_paths; i++) free(files.paths[i]);
+    free(files.paths);
+
+    return state.n_failed > 0 ? 1 : 0;
+}
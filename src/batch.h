@@ -0,0 +1,20 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+// Offline batch transcription for the transcribe tool - loads the model once
+// and spreads a directory (or a list file) of recordings across parallel
+// decoder states, writing one JSON line per file plus a throughput summary.
+
+typedef struct {
+    const char *input;       // Directory of audio files, or a text file with one path per line
+    const char *model_path;
+    const char *output_path; // JSONL results
+    const char *language;    // "auto" detects per file
+    int jobs;                // Files transcribed at once, one decoder state each
+    int threads_per_job;     // Inference threads per file; 0 splits the tuned count across jobs
+} BatchOptions;
+
+// Returns 0 if every file was transcribed, 1 otherwise
+int batch_run(const BatchOptions *options);
+
+#endif // BATCH_H
@@ -0,0 +1,550 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_input.h"
+#include "model_definitions.h"
+#include "stats.h"
+#include "transcript_output.h"
+#include "transcription.h"
+#include "utils.h"
+#include "whisper.h"
+
+// yakety-bench - end-to-end latency benchmark with JSON output, for catching
+// regressions across whisper.cpp bumps and settings changes. Runs on the
+// built-in default settings (the user's preferences are not loaded) so results
+// compare across machines and accounts.
+
+#define SAMPLE_RATE 16000
+#define MAX_MODELS 8
+#define MAX_LENGTHS 16
+#define MAX_THREAD_COUNTS 32
+#define MAX_PROFILES 8
+
+typedef struct {
+    int iterations;
+    int warmup_runs;
+    int lengths[MAX_LENGTHS]; // Utterance lengths in seconds
+    int n_lengths;
+    int threads[MAX_THREAD_COUNTS]; // Thread sweep; empty means pick from the CPU topology
+    int n_threads;
+    bool sweep_threads;
+    bool sweep_vad;
+    const char *profiles[MAX_PROFILES]; // Decoding profiles to compare; empty means all of them
+    int n_profiles;
+    const char *models[MAX_MODELS];
+    int n_models;
+    const char *audio_path; // Corpus audio, or NULL for the synthetic clip
+    const char *output_path;
+} BenchConfig;
+
+typedef struct {
+    double p50_ms;
+    double p95_ms;
+    double p99_ms;
+    double mean_ms;
+    double min_ms;
+    double max_ms;
+} LatencyStats;
+
+static void compute_stats(double *times_ms, int n, LatencyStats *stats) {
+    stats_sort(times_ms, n);
+
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) {
+        sum += times_ms[i];
+    }
+    stats->p50_ms = stats_percentile(times_ms, n, 50.0);
+    stats->p95_ms = stats_percentile(times_ms, n, 95.0);
+    stats->p99_ms = stats_percentile(times_ms, n, 99.0);
+    stats->mean_ms = sum / n;
+    stats->min_ms = times_ms[0];
+    stats->max_ms = times_ms[n - 1];
+}
+
+// Deterministic speech-like signal: a voiced source with a drifting 120 Hz
+// pitch, shaped by two formants that change every syllable, with a 4 Hz
+// syllable envelope and a pause every eighth syllable. Enough for the VAD to
+// keep it and for the decoder to do representative work.
+static float *synthetic_speech(int n_samples) {
+    static const float formants[][2] = {
+        {730.0f, 1090.0f}, {270.0f, 2290.0f}, {530.0f, 1840.0f}, {300.0f, 870.0f}, {640.0f, 1190.0f},
+    };
+    const int n_vowels = (int) (sizeof(formants) / sizeof(formants[0]));
+    const int syllable_samples = SAMPLE_RATE / 4;
+    const float two_pi = 6.283185307f;
+
+    float *samples = (float *) malloc((size_t) n_samples * sizeof(float));
+    if (!samples) {
+        return NULL;
+    }
+
+    unsigned int seed = 12345;
+    float phase = 0.0f;
+    float f1 = formants[0][0];
+    float f2 = formants[0][1];
+    for (int i = 0; i < n_samples; i++) {
+        int syllable = i / syllable_samples;
+        int offset = i % syllable_samples;
+        if (offset == 0) {
+            seed = seed * 1103515245u + 12345u;
+            int vowel = (int) ((seed >> 16) % (unsigned int) n_vowels);
+            f1 = formants[vowel][0];
+            f2 = formants[vowel][1];
+        }
+
+        float t = (float) i / SAMPLE_RATE;
+        float f0 = 120.0f * (1.0f + 0.05f * sinf(two_pi * 0.5f * t));
+        phase += two_pi * f0 / SAMPLE_RATE;
+        if (phase > two_pi) {
+            phase -= two_pi;
+        }
+
+        float value = 0.0f;
+        if (syllable % 8 != 7) {
+            for (int k = 1; k <= 30; k++) {
+                float freq = k * f0;
+                float a1 = (freq - f1) / 100.0f;
+                float a2 = (freq - f2) / 120.0f;
+                float gain = 1.0f / (1.0f + a1 * a1) + 0.5f / (1.0f + a2 * a2);
+                value += gain * sinf(k * phase) / k;
+            }
+            value *= sinf(3.14159265f * offset / syllable_samples);
+        }
+
+        seed = seed * 1103515245u + 12345u;
+        float noise = ((float) ((seed >> 16) & 0x7fff) / 32767.0f - 0.5f) * 0.002f;
+        samples[i] = 0.25f * value + noise;
+    }
+
+    return samples;
+}
+
+// Read a recording as 16 kHz mono and loop it to n_samples
+static float *corpus_audio(const char *path, int n_samples) {
+    AudioInput *input = audio_input_open(path);
+    if (!input) {
+        fprintf(stderr, "Error: Could not decode audio file: %s\n", path);
+        return NULL;
+    }
+
+    float *samples = (float *) malloc((size_t) n_samples * sizeof(float));
+    int n_read = 0;
+    while (samples && n_read < n_samples) {
+        int n = audio_input_read(input, samples + n_read, n_samples - n_read);
+        if (n == 0) {
+            break;
+        }
+        n_read += n;
+    }
+    audio_input_close(input);
+
+    if (samples && n_read == 0) {
+        fprintf(stderr, "Error: No audio in %s\n", path);
+        free(samples);
+        return NULL;
+    }
+    for (int i = n_read; samples && i < n_samples; i++) {
+        samples[i] = samples[i % n_read];
+    }
+    return samples;
+}
+
+static void json_stats(FILE *out, const LatencyStats *stats, double audio_seconds) {
+    fprintf(out, "\"p50_ms\": %.2f, \"p95_ms\": %.2f, \"p99_ms\": %.2f, \"mean_ms\": %.2f, "
+                 "\"min_ms\": %.2f, \"max_ms\": %.2f, \"rtf_p50\": %.4f",
+            stats->p50_ms, stats->p95_ms, stats->p99_ms, stats->mean_ms, stats->min_ms, stats->max_ms,
+            stats->p50_ms / 1000.0 / audio_seconds);
+}
+
+// Time iterations transcriptions of the first n_samples of audio.
+// Returns false if any of them failed.
+static bool measure(const float *audio, int n_samples, bool vad, const BenchConfig *config, LatencyStats *stats) {
+    double *times_ms = (double *) malloc((size_t) config->iterations * sizeof(double));
+    if (!times_ms) {
+        return false;
+    }
+
+    for (int i = 0; i < config->warmup_runs + config->iterations; i++) {
+        double start = utils_now();
+        char *text = vad ? transcription_process(audio, n_samples, SAMPLE_RATE)
+                         : transcription_process_speech(audio, n_samples);
+        double duration_ms = (utils_now() - start) * 1000.0;
+        if (!text) {
+            free(times_ms);
+            return false;
+        }
+        free(text);
+        if (i >= config->warmup_runs) {
+            times_ms[i - config->warmup_runs] = duration_ms;
+        }
+    }
+
+    compute_stats(times_ms, config->iterations, stats);
+    free(times_ms);
+    return true;
+}
+
+// Time a model load that nothing else in this process has paid for yet, then
+// a second one with the file in the page cache and the backends initialized
+static bool measure_load(const char *model_path, double *cold_ms, double *warm_ms) {
+    double *results[2] = {cold_ms, warm_ms};
+    for (int i = 0; i < 2; i++) {
+        double start = utils_now();
+        TranscriptionEngine *engine = transcription_engine_create(model_path, 1);
+        *results[i] = (utils_now() - start) * 1000.0;
+        if (!engine) {
+            return false;
+        }
+        transcription_engine_free(engine);
+    }
+    return true;
+}
+
+static int compare_ints(const void *a, const void *b) {
+    return *(const int *) a - *(const int *) b;
+}
+
+// Powers of two plus the core counts that matter on this CPU, ascending
+static int default_thread_counts(int *counts) {
+    utils_cpu_info_t cpu;
+    utils_get_cpu_info(&cpu);
+
+    int candidates[MAX_THREAD_COUNTS];
+    int n = 0;
+    for (int t = 1; t < cpu.logical_cpus && n < MAX_THREAD_COUNTS - 3; t *= 2) {
+        candidates[n++] = t;
+    }
+    candidates[n++] = cpu.performance_cores;
+    candidates[n++] = cpu.physical_cores;
+    candidates[n++] = cpu.logical_cpus;
+    qsort(candidates, n, sizeof(int), compare_ints);
+
+    int n_counts = 0;
+    for (int i = 0; i < n; i++) {
+        if (candidates[i] >= 1 && (n_counts == 0 || counts[n_counts - 1] != candidates[i])) {
+            counts[n_counts++] = candidates[i];
+        }
+    }
+    return n_counts;
+}
+
+// The model the app would use by default plus every downloaded model
+static int installed_models(const char **models, int max_models) {
+    static char paths[DOWNLOADABLE_MODELS_COUNT][1024];
+    int n = 0;
+
+    const char *bundled = utils_get_model_path();
+    if (bundled) {
+        models[n++] = bundled;
+    }
+
+    const char *config_dir = utils_get_config_dir();
+    for (size_t i = 0; config_dir && i < DOWNLOADABLE_MODELS_COUNT && n < max_models; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "%s/models/%s", config_dir, DOWNLOADABLE_MODELS[i].filename);
+        FILE *file = utils_fopen_read_binary(paths[i]);
+        if (file) {
+            fclose(file);
+            models[n++] = paths[i];
+        }
+    }
+    return n;
+}
+
+static int parse_int_list(const char *arg, int *values, int max_values) {
+    int n = 0;
+    const char *p = arg;
+    while (*p && n < max_values) {
+        char *end;
+        long value = strtol(p, &end, 10);
+        if (end == p || value < 1) {
+            return -1;
+        }
+        values[n++] = (int) value;
+        p = *end == ',' ? end + 1 : end;
+        if (*end != ',' && *end != '\0') {
+            return -1;
+        }
+    }
+    return n;
+}
+
+static bool is_profile(const char *name) {
+    for (int i = 0; i < transcription_profile_count(); i++) {
+        if (strcmp(name, transcription_profile_name(i)) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Split a comma-separated list of decoding profiles, in place; -1 for an unknown name
+static int parse_profile_list(char *arg, const char **names, int max_names) {
+    int n = 0;
+    for (char *name = strtok(arg, ","); name && n < max_names; name = strtok(NULL, ",")) {
+        if (!is_profile(name)) {
+            return -1;
+        }
+        names[n++] = name;
+    }
+    return n;
+}
+
+// Benchmark one model and append its JSON object to out
+static bool bench_model(FILE *out, const char *model_path, const float *audio, const BenchConfig *config) {
+    fprintf(stderr, "== %s\n", model_path);
+
+    const char *name = strrchr(model_path, '/');
+    const char *backslash = strrchr(model_path, '\\');
+    if (backslash > name) name = backslash;
+
+    fprintf(out, "    {\n      \"model\": ");
+    transcript_json_string(out, name ? name + 1 : model_path);
+    fprintf(out, ",\n      \"path\": ");
+    transcript_json_string(out, model_path);
+
+    double cold_ms = 0.0;
+    double warm_ms = 0.0;
+    if (!measure_load(model_path, &cold_ms, &warm_ms) || transcription_init(model_path) != 0) {
+        fprintf(stderr, "Error: Failed to load model: %s\n", model_path);
+        fprintf(out, ",\n      \"error\": \"load failed\"\n    }");
+        return false;
+    }
+    fprintf(stderr, "   load: %.0f ms cold, %.0f ms warm\n", cold_ms, warm_ms);
+
+    transcription_set_language("en");
+    TranscriptionEngine *engine = transcription_get_engine();
+    const int default_threads = transcription_engine_get_threads(engine);
+    TranscriptionStats stats_before;
+    transcription_get_stats(&stats_before);
+
+    fprintf(out, ",\n      \"load_ms\": {\"cold\": %.2f, \"warm\": %.2f},\n", cold_ms, warm_ms);
+    fprintf(out, "      \"default_threads\": %d,\n", default_threads);
+
+    // Latency by utterance length, with and without the VAD pass
+    bool ok = true;
+    bool first = true;
+    fprintf(out, "      \"latency\": [");
+    for (int v = 0; v < (config->sweep_vad ? 2 : 1) && ok; v++) {
+        bool vad = v == 1;
+        for (int i = 0; i < config->n_lengths && ok; i++) {
+            LatencyStats stats;
+            int n_samples = config->lengths[i] * SAMPLE_RATE;
+            ok = measure(audio, n_samples, vad, config, &stats);
+            if (!ok) {
+                break;
+            }
+            fprintf(stderr, "   %2d s, VAD %-3s: p50 %.0f ms, p95 %.0f ms, p99 %.0f ms\n", config->lengths[i],
+                    vad ? "on" : "off", stats.p50_ms, stats.p95_ms, stats.p99_ms);
+            fprintf(out, "%s\n        {\"length_s\": %d, \"vad\": %s, \"threads\": %d, ", first ? "" : ",",
+                    config->lengths[i], vad ? "true" : "false", default_threads);
+            json_stats(out, &stats, config->lengths[i]);
+            fprintf(out, "}");
+            first = false;
+        }
+    }
+    fprintf(out, "\n      ],\n");
+
+    // Thread sweep on the middle utterance length, without VAD so only inference is timed
+    int counts[MAX_THREAD_COUNTS];
+    int n_counts = config->n_threads > 0 ? config->n_threads : default_thread_counts(counts);
+    if (config->n_threads > 0) {
+        memcpy(counts, config->threads, (size_t) n_counts * sizeof(int));
+    }
+    int sweep_length = config->lengths[config->n_lengths / 2];
+
+    first = true;
+    fprintf(out, "      \"thread_sweep\": [");
+    for (int i = 0; i < n_counts && ok && config->sweep_threads; i++) {
+        LatencyStats stats;
+        transcription_engine_set_threads(engine, counts[i]);
+        ok = measure(audio, sweep_length * SAMPLE_RATE, false, config, &stats);
+        if (!ok) {
+            break;
+        }
+        fprintf(stderr, "   %2d threads (%d s): p50 %.0f ms, p95 %.0f ms\n", counts[i], sweep_length, stats.p50_ms,
+                stats.p95_ms);
+        fprintf(out, "%s\n        {\"threads\": %d, \"length_s\": %d, ", first ? "" : ",", counts[i], sweep_length);
+        json_stats(out, &stats, sweep_length);
+        fprintf(out, "}");
+        first = false;
+    }
+    transcription_engine_set_threads(engine, default_threads);
+
+    // Every length under each decoding profile, without VAD so only decoding differs
+    first = true;
+    fprintf(out, "\n      ],\n      \"profiles\": [");
+    for (int p = 0; p < config->n_profiles && ok; p++) {
+        if (!transcription_set_profile(config->profiles[p])) {
+            continue;
+        }
+        for (int i = 0; i < config->n_lengths && ok; i++) {
+            LatencyStats stats;
+            ok = measure(audio, config->lengths[i] * SAMPLE_RATE, false, config, &stats);
+            if (!ok) {
+                break;
+            }
+            fprintf(stderr, "   %-8s %2d s: p50 %.0f ms, p95 %.0f ms\n", config->profiles[p], config->lengths[i],
+                    stats.p50_ms, stats.p95_ms);
+            fprintf(out, "%s\n        {\"profile\": ", first ? "" : ",");
+            transcript_json_string(out, config->profiles[p]);
+            fprintf(out, ", \"length_s\": %d, ", config->lengths[i]);
+            json_stats(out, &stats, config->lengths[i]);
+            fprintf(out, "}");
+            first = false;
+        }
+    }
+    transcription_set_profile(NULL);
+
+    // Decodes the repetition monitor cut short; synthetic speech can trigger it
+    TranscriptionStats stats_after;
+    transcription_get_stats(&stats_after);
+    fprintf(out, "\n      ],\n      \"loops_stopped\": %d", stats_after.loops_stopped - stats_before.loops_stopped);
+    fprintf(out, "%s\n    }", ok ? "" : ",\n      \"error\": \"transcription failed\"");
+
+    transcription_cleanup();
+    if (!ok) {
+        fprintf(stderr, "Error: Transcription failed with %s\n", model_path);
+    }
+    return ok;
+}
+
+static void print_usage(const char *program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  --model PATH        Benchmark this model (repeatable; default: every installed model)\n");
+    printf("  --audio FILE        Slice utterances from this recording instead of synthetic speech\n");
+    printf("  --iterations N      Timed runs per measurement (default: 10)\n");
+    printf("  --warmup N          Untimed runs before each measurement (default: 1)\n");
+    printf("  --lengths LIST      Utterance lengths in seconds (default: 1,3,5,10,20)\n");
+    printf("  --threads LIST      Thread counts to sweep (default: chosen from the CPU topology)\n");
+    printf("  --no-thread-sweep   Skip the thread sweep\n");
+    printf("  --no-vad            Only measure without the VAD pass\n");
+    printf("  --profiles LIST     Decoding profiles to compare (default: fast,balanced,accurate)\n");
+    printf("  --no-profile-sweep  Skip the decoding profile comparison\n");
+    printf("  --output FILE       Write JSON results here (default: yakety-bench.json, - for stdout)\n");
+}
+
+int main(int argc, char *argv[]) {
+    BenchConfig config = {0};
+    config.iterations = 10;
+    config.warmup_runs = 1;
+    config.n_lengths = parse_int_list("1,3,5,10,20", config.lengths, MAX_LENGTHS);
+    config.sweep_threads = true;
+    config.sweep_vad = true;
+    config.output_path = "yakety-bench.json";
+    bool sweep_profiles = true;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        bool takes_value = true;
+
+        if (strcmp(arg, "--model") == 0 && value && config.n_models < MAX_MODELS) {
+            config.models[config.n_models++] = value;
+        } else if (strcmp(arg, "--audio") == 0 && value) {
+            config.audio_path = value;
+        } else if (strcmp(arg, "--iterations") == 0 && value && atoi(value) > 0) {
+            config.iterations = atoi(value);
+        } else if (strcmp(arg, "--warmup") == 0 && value && atoi(value) >= 0) {
+            config.warmup_runs = atoi(value);
+        } else if (strcmp(arg, "--lengths") == 0 && value) {
+            config.n_lengths = parse_int_list(value, config.lengths, MAX_LENGTHS);
+        } else if (strcmp(arg, "--threads") == 0 && value) {
+            config.n_threads = parse_int_list(value, config.threads, MAX_THREAD_COUNTS);
+        } else if (strcmp(arg, "--output") == 0 && value) {
+            config.output_path = value;
+        } else if (strcmp(arg, "--profiles") == 0 && value) {
+            config.n_profiles = parse_profile_list(argv[i + 1], config.profiles, MAX_PROFILES);
+            sweep_profiles = true;
+        } else if (strcmp(arg, "--no-thread-sweep") == 0) {
+            config.sweep_threads = false;
+            takes_value = false;
+        } else if (strcmp(arg, "--no-vad") == 0) {
+            config.sweep_vad = false;
+            takes_value = false;
+        } else if (strcmp(arg, "--no-profile-sweep") == 0) {
+            sweep_profiles = false;
+            takes_value = false;
+        } else {
+            print_usage(argv[0]);
+            return strcmp(arg, "--help") == 0 ? 0 : 1;
+        }
+        if (takes_value) {
+            i++;
+        }
+    }
+
+    if (config.n_lengths <= 0 || config.n_threads < 0 || config.n_profiles < 0) {
+        fprintf(stderr, "Error: Invalid --lengths, --threads or --profiles list\n");
+        return 1;
+    }
+    if (!sweep_profiles) {
+        config.n_profiles = 0;
+    } else if (config.n_profiles == 0) {
+        for (int i = 0; i < transcription_profile_count() && i < MAX_PROFILES; i++) {
+            config.profiles[config.n_profiles++] = transcription_profile_name(i);
+        }
+    }
+    if (config.n_models == 0) {
+        config.n_models = installed_models(config.models, MAX_MODELS);
+    }
+    if (config.n_models == 0) {
+        fprintf(stderr, "Error: Could not find any Whisper model\n");
+        return 1;
+    }
+
+    int max_length = 0;
+    for (int i = 0; i < config.n_lengths; i++) {
+        if (config.lengths[i] > max_length) max_length = config.lengths[i];
+    }
+    int n_samples = max_length * SAMPLE_RATE;
+    float *audio = config.audio_path ? corpus_audio(config.audio_path, n_samples) : synthetic_speech(n_samples);
+    if (!audio) {
+        return 1;
+    }
+
+    FILE *out = strcmp(config.output_path, "-") == 0 ? stdout : utils_fopen_write(config.output_path);
+    if (!out) {
+        fprintf(stderr, "Error: Could not write %s\n", config.output_path);
+        free(audio);
+        return 1;
+    }
+
+    utils_cpu_info_t cpu;
+    utils_get_cpu_info(&cpu);
+    char timestamp[32];
+    time_t now = time(NULL);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(out, "{\n  \"version\": 1,\n  \"timestamp\": \"%s\",\n", timestamp);
+    fprintf(out, "  \"cpu\": {\"name\": ");
+    transcript_json_string(out, cpu.name);
+    fprintf(out, ", \"logical\": %d, \"physical\": %d, \"performance\": %d},\n", cpu.logical_cpus,
+            cpu.physical_cores, cpu.performance_cores);
+    fprintf(out, "  \"whisper_system_info\": ");
+    transcript_json_string(out, whisper_print_system_info());
+    fprintf(out, ",\n  \"audio\": ");
+    transcript_json_string(out, config.audio_path ? config.audio_path : "synthetic");
+    fprintf(out, ",\n  \"iterations\": %d,\n  \"warmup_runs\": %d,\n  \"models\": [\n", config.iterations,
+            config.warmup_runs);
+
+    int failures = 0;
+    for (int i = 0; i < config.n_models; i++) {
+        if (i > 0) {
+            fprintf(out, ",\n");
+        }
+        if (!bench_model(out, config.models[i], audio, &config)) {
+            failures++;
+        }
+    }
+    fprintf(out, "\n  ]\n}\n");
+
+    if (out != stdout) {
+        fclose(out);
+        fprintf(stderr, "Results written to %s\n", config.output_path);
+    }
+    free(audio);
+    return failures > 0 ? 1 : 0;
+}
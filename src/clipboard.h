@@ -3,5 +3,10 @@
 
 void clipboard_copy(const char *text);
 void clipboard_paste(void);
+// Press Backspace count times in the focused application
+void clipboard_backspace(int count);
+// Token for the window or application that has keyboard focus, 0 if unknown;
+// equal tokens mean the focus is still where it was
+unsigned long long clipboard_focused_window(void);
 
 #endif// CLIPBOARD_H
\ No newline at end of file
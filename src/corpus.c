@@ -0,0 +1,676 @@
+#include "corpus.h"
+#include "audio_input.h"
+#include "preferences.h"
+#include "stats.h"
+#include "transcript_output.h"
+#include "transcription.h"
+#include "utils.h"
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLE_RATE 16000
+#define MAX_LINE_LENGTH 8192
+#define MAX_OVERRIDES 16
+
+typedef struct {
+    char *path;
+    char *reference;
+} CorpusClip;
+
+typedef struct {
+    char *hypothesis;
+    double wer;
+    double cer;
+    double ms;
+    double audio_seconds;
+    bool failed;
+} ClipResult;
+
+typedef struct {
+    char model[256];
+    char profile[64];
+    int n_clips;
+    int n_failed;
+    double wer; // Corpus-level: total edits over total reference length
+    double cer;
+    double rtf; // Total processing time over total audio duration
+    double p50_ms;
+    double p95_ms;
+    ClipResult *clips;
+} CorpusResult;
+
+typedef struct {
+    char name[64];
+    char keys[MAX_OVERRIDES][128];
+    char values[MAX_OVERRIDES][256];
+    int n_overrides;
+} Profile;
+
+// ---------------------------------------------------------------------------
+// Text metrics
+
+// Lowercase, turn punctuation into spaces (apostrophes and non-ASCII bytes are
+// kept), collapse whitespace. Returns malloc'd string.
+static char *normalize_text(const char *text) {
+    size_t length = strlen(text);
+    char *out = (char *) malloc(length + 1);
+    if (!out) {
+        return NULL;
+    }
+
+    size_t n = 0;
+    bool space = true; // Drops leading spaces
+    for (const char *p = text; *p; p++) {
+        unsigned char c = (unsigned char) *p;
+        if (c >= 0x80 || isalnum(c) || c == '\'') {
+            out[n++] = (char) (c < 0x80 ? tolower(c) : c);
+            space = false;
+        } else if (!space) {
+            out[n++] = ' ';
+            space = true;
+        }
+    }
+    if (n > 0 && out[n - 1] == ' ') {
+        n--;
+    }
+    out[n] = '\0';
+    return out;
+}
+
+static int edit_distance(const int *a, int n, const int *b, int m) {
+    int *prev = (int *) malloc((size_t) (m + 1) * sizeof(int));
+    int *cur = (int *) malloc((size_t) (m + 1) * sizeof(int));
+    if (!prev || !cur) {
+        free(prev);
+        free(cur);
+        return n > m ? n : m;
+    }
+
+    for (int j = 0; j <= m; j++) {
+        prev[j] = j;
+    }
+    for (int i = 1; i <= n; i++) {
+        cur[0] = i;
+        for (int j = 1; j <= m; j++) {
+            int substitute = prev[j - 1] + (a[i - 1] == b[j - 1] ? 0 : 1);
+            int remove = prev[j] + 1;
+            int insert = cur[j - 1] + 1;
+            int best = substitute < remove ? substitute : remove;
+            cur[j] = best < insert ? best : insert;
+        }
+        int *swap = prev;
+        prev = cur;
+        cur = swap;
+    }
+
+    int distance = prev[m];
+    free(prev);
+    free(cur);
+    return distance;
+}
+
+// Split normalized text into words and give equal words equal ids.
+// Words are looked up in (and added to) dict, which holds *n_dict entries.
+static int *word_ids(char *text, char ***dict, int *n_dict, int *n_words) {
+    int capacity = 1;
+    for (const char *p = text; *p; p++) {
+        if (*p == ' ') capacity++;
+    }
+    int *ids = (int *) malloc((size_t) capacity * sizeof(int));
+    char **grown = (char **) realloc(*dict, (size_t) (*n_dict + capacity) * sizeof(char *));
+    if (!ids || !grown) {
+        free(ids);
+        if (grown) *dict = grown;
+        return NULL;
+    }
+    *dict = grown;
+
+    *n_words = 0;
+    char *word = text;
+    while (*word) {
+        char *end = strchr(word, ' ');
+        if (end) *end = '\0';
+
+        int id = -1;
+        for (int i = 0; i < *n_dict && id < 0; i++) {
+            if (strcmp((*dict)[i], word) == 0) id = i;
+        }
+        if (id < 0) {
+            id = *n_dict;
+            (*dict)[(*n_dict)++] = word;
+        }
+        ids[(*n_words)++] = id;
+
+        if (!end) break;
+        word = end + 1;
+    }
+    return ids;
+}
+
+int corpus_word_errors(const char *hypothesis, const char *reference, int *ref_length) {
+    char *hyp = normalize_text(hypothesis ? hypothesis : "");
+    char *ref = normalize_text(reference ? reference : "");
+    char **dict = NULL;
+    int n_dict = 0;
+    int n_hyp = 0;
+    int n_ref = 0;
+    int *hyp_ids = hyp ? word_ids(hyp, &dict, &n_dict, &n_hyp) : NULL;
+    int *ref_ids = ref ? word_ids(ref, &dict, &n_dict, &n_ref) : NULL;
+
+    int errors = hyp_ids && ref_ids ? edit_distance(hyp_ids, n_hyp, ref_ids, n_ref) : n_ref;
+    if (ref_length) {
+        *ref_length = n_ref;
+    }
+
+    free(hyp_ids);
+    free(ref_ids);
+    free(dict);
+    free(hyp);
+    free(ref);
+    return errors;
+}
+
+// Decode UTF-8 into code points; invalid bytes count as one character each
+static int *code_points(const char *text, int *n_points) {
+    int *points = (int *) malloc((strlen(text) + 1) * sizeof(int));
+    *n_points = 0;
+    if (!points) {
+        return NULL;
+    }
+
+    const unsigned char *p = (const unsigned char *) text;
+    while (*p) {
+        int extra = *p >= 0xf0 ? 3 : (*p >= 0xe0 ? 2 : (*p >= 0xc0 ? 1 : 0));
+        int point = extra ? (*p & (0x3f >> extra)) : *p;
+        p++;
+        for (int i = 0; i < extra && (*p & 0xc0) == 0x80; i++, p++) {
+            point = (point << 6) | (*p & 0x3f);
+        }
+        points[(*n_points)++] = point;
+    }
+    return points;
+}
+
+int corpus_char_errors(const char *hypothesis, const char *reference, int *ref_length) {
+    char *hyp = normalize_text(hypothesis ? hypothesis : "");
+    char *ref = normalize_text(reference ? reference : "");
+    int n_hyp = 0;
+    int n_ref = 0;
+    int *hyp_points = hyp ? code_points(hyp, &n_hyp) : NULL;
+    int *ref_points = ref ? code_points(ref, &n_ref) : NULL;
+
+    int errors = hyp_points && ref_points ? edit_distance(hyp_points, n_hyp, ref_points, n_ref) : n_ref;
+    if (ref_length) {
+        *ref_length = n_ref;
+    }
+
+    free(hyp_points);
+    free(ref_points);
+    free(hyp);
+    free(ref);
+    return errors;
+}
+
+// ---------------------------------------------------------------------------
+// Inputs
+
+static void free_clips(CorpusClip *clips, int n_clips) {
+    for (int i = 0; i < n_clips; i++) {
+        free(clips[i].path);
+        free(clips[i].reference);
+    }
+    free(clips);
+}
+
+static bool is_absolute_path(const char *path) {
+    return path[0] == '/' || path[0] == '\\' || (isalpha((unsigned char) path[0]) && path[1] == ':');
+}
+
+static CorpusClip *load_manifest(const char *manifest_path, int *n_clips) {
+    FILE *file = utils_fopen_read(manifest_path);
+    if (!file) {
+        printf("Error: Could not open manifest: %s\n", manifest_path);
+        return NULL;
+    }
+
+    // Relative clip paths are relative to the manifest
+    char base[1024];
+    snprintf(base, sizeof(base), "%s", manifest_path);
+    char *slash = strrchr(base, '/');
+    char *backslash = strrchr(base, '\\');
+    if (backslash > slash) slash = backslash;
+    if (slash) {
+        slash[1] = '\0';
+    } else {
+        base[0] = '\0';
+    }
+
+    CorpusClip *clips = NULL;
+    int capacity = 0;
+    *n_clips = 0;
+
+    char line[MAX_LINE_LENGTH];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+
+        char *tab = strchr(line, '\t');
+        if (!tab) {
+            printf("Warning: %s:%d has no reference transcript, skipped\n", manifest_path, line_number);
+            continue;
+        }
+        *tab = '\0';
+
+        if (*n_clips == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            CorpusClip *grown = (CorpusClip *) realloc(clips, (size_t) capacity * sizeof(CorpusClip));
+            if (!grown) {
+                break;
+            }
+            clips = grown;
+        }
+
+        char path[2048];
+        snprintf(path, sizeof(path), "%s%s", is_absolute_path(line) ? "" : base, line);
+        clips[*n_clips].path = utils_strdup(path);
+        clips[*n_clips].reference = utils_strdup(tab + 1);
+        (*n_clips)++;
+    }
+    fclose(file);
+
+    if (*n_clips == 0) {
+        printf("Error: No clips in manifest: %s\n", manifest_path);
+        free(clips);
+        return NULL;
+    }
+    return clips;
+}
+
+static bool parse_profile(const char *spec, Profile *profile) {
+    memset(profile, 0, sizeof(*profile));
+
+    const char *colon = strchr(spec, ':');
+    size_t name_length = colon ? (size_t) (colon - spec) : strlen(spec);
+    if (name_length == 0 || name_length >= sizeof(profile->name)) {
+        return false;
+    }
+    memcpy(profile->name, spec, name_length);
+
+    const char *p = colon ? colon + 1 : "";
+    while (*p) {
+        const char *end = strchr(p, ',');
+        size_t length = end ? (size_t) (end - p) : strlen(p);
+        const char *equals = memchr(p, '=', length);
+        if (!equals || equals == p || profile->n_overrides == MAX_OVERRIDES) {
+            return false;
+        }
+
+        int i = profile->n_overrides++;
+        snprintf(profile->keys[i], sizeof(profile->keys[i]), "%.*s", (int) (equals - p), p);
+        snprintf(profile->values[i], sizeof(profile->values[i]), "%.*s", (int) (length - (equals - p) - 1),
+                 equals + 1);
+        p = end ? end + 1 : p + length;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Running
+
+static const char *file_name(const char *path) {
+    const char *slash = strrchr(path, '/');
+    const char *backslash = strrchr(path, '\\');
+    if (backslash > slash) slash = backslash;
+    return slash ? slash + 1 : path;
+}
+
+// Transcribe the corpus with the loaded model. Fills in result; returns false
+// if every clip failed.
+static bool run_clips(const CorpusClip *clips, int n_clips, CorpusResult *result) {
+    result->clips = (ClipResult *) calloc((size_t) n_clips, sizeof(ClipResult));
+    double *times = (double *) malloc((size_t) n_clips * sizeof(double));
+    if (!result->clips || !times) {
+        free(times);
+        return false;
+    }
+
+    long word_errors = 0, words = 0, char_errors = 0, chars = 0;
+    double total_ms = 0.0, total_audio = 0.0;
+    int n_times = 0;
+
+    for (int i = 0; i < n_clips; i++) {
+        ClipResult *clip = &result->clips[i];
+        int n_samples = 0;
+        float *samples = audio_input_read_file(clips[i].path, &n_samples);
+        if (!samples) {
+            printf("  ! %s: could not read audio\n", clips[i].path);
+            clip->failed = true;
+            result->n_failed++;
+            continue;
+        }
+
+        double start = utils_now();
+        char *text = transcription_process(samples, n_samples, SAMPLE_RATE);
+        clip->ms = (utils_now() - start) * 1000.0;
+        clip->audio_seconds = (double) n_samples / SAMPLE_RATE;
+        free(samples);
+
+        if (!text) {
+            printf("  ! %s: transcription failed\n", clips[i].path);
+            clip->failed = true;
+            result->n_failed++;
+            continue;
+        }
+
+        int n_words = 0, n_chars = 0;
+        int w = corpus_word_errors(text, clips[i].reference, &n_words);
+        int c = corpus_char_errors(text, clips[i].reference, &n_chars);
+        clip->hypothesis = text;
+        clip->wer = n_words > 0 ? (double) w / n_words : (w > 0 ? 1.0 : 0.0);
+        clip->cer = n_chars > 0 ? (double) c / n_chars : (c > 0 ? 1.0 : 0.0);
+
+        word_errors += w;
+        words += n_words;
+        char_errors += c;
+        chars += n_chars;
+        total_ms += clip->ms;
+        total_audio += clip->audio_seconds;
+        times[n_times++] = clip->ms;
+
+        printf("  %-40s WER %5.1f%%  CER %5.1f%%  %6.0f ms  RTF %.3f\n", file_name(clips[i].path),
+               clip->wer * 100.0, clip->cer * 100.0, clip->ms, clip->ms / 1000.0 / clip->audio_seconds);
+    }
+
+    result->n_clips = n_clips;
+    result->wer = words > 0 ? (double) word_errors / words : 0.0;
+    result->cer = chars > 0 ? (double) char_errors / chars : 0.0;
+    result->rtf = total_audio > 0.0 ? total_ms / 1000.0 / total_audio : 0.0;
+    if (n_times > 0) {
+        stats_sort(times, n_times);
+        result->p50_ms = stats_percentile(times, n_times, 50.0);
+        result->p95_ms = stats_percentile(times, n_times, 95.0);
+    }
+    free(times);
+    return n_times > 0;
+}
+
+// Apply a profile's overrides, remembering what they replaced
+static void apply_profile(const Profile *profile, char **saved) {
+    for (int i = 0; i < profile->n_overrides; i++) {
+        const char *old = preferences_get_string(profile->keys[i]);
+        saved[i] = old ? utils_strdup(old) : NULL;
+        preferences_set_string(profile->keys[i], profile->values[i]);
+    }
+}
+
+static void restore_profile(const Profile *profile, char **saved) {
+    for (int i = 0; i < profile->n_overrides; i++) {
+        if (saved[i]) {
+            preferences_set_string(profile->keys[i], saved[i]);
+        } else {
+            preferences_remove(profile->keys[i]); // Unset before, so back to the built-in default
+        }
+        free(saved[i]);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Report and baseline
+
+static bool write_report(const char *path, const char *manifest_path, const CorpusClip *clips,
+                         const CorpusResult *results, int n_results) {
+    FILE *out = utils_fopen_write(path);
+    if (!out) {
+        printf("Error: Could not write report: %s\n", path);
+        return false;
+    }
+
+    fprintf(out, "{\n  \"version\": 1,\n  \"manifest\": ");
+    transcript_json_string(out, manifest_path);
+    fprintf(out, ",\n  \"results\": [");
+    for (int r = 0; r < n_results; r++) {
+        const CorpusResult *result = &results[r];
+        // Summary fields come before "files" on purpose; the baseline reader relies on it
+        fprintf(out, "%s\n    {\"model\": ", r ? "," : "");
+        transcript_json_string(out, result->model);
+        fprintf(out, ", \"profile\": ");
+        transcript_json_string(out, result->profile);
+        fprintf(out, ", \"clips\": %d, \"failed\": %d, \"wer\": %.5f, \"cer\": %.5f, \"rtf\": %.5f, "
+                     "\"p50_ms\": %.2f, \"p95_ms\": %.2f,\n     \"files\": [",
+                result->n_clips, result->n_failed, result->wer, result->cer, result->rtf, result->p50_ms,
+                result->p95_ms);
+        for (int i = 0; i < result->n_clips; i++) {
+            const ClipResult *clip = &result->clips[i];
+            fprintf(out, "%s\n       {\"path\": ", i ? "," : "");
+            transcript_json_string(out, clips[i].path);
+            if (clip->failed) {
+                fprintf(out, ", \"failed\": true}");
+                continue;
+            }
+            fprintf(out, ", \"wer\": %.5f, \"cer\": %.5f, \"ms\": %.2f, \"rtf\": %.5f, \"hypothesis\": ", clip->wer,
+                    clip->cer, clip->ms, clip->ms / 1000.0 / clip->audio_seconds);
+            transcript_json_string(out, clip->hypothesis);
+            fprintf(out, "}");
+        }
+        fprintf(out, "\n     ]}");
+    }
+    fprintf(out, "\n  ]\n}\n");
+    fclose(out);
+
+    printf("Report written to %s\n", path);
+    return true;
+}
+
+static char *read_file(const char *path) {
+    FILE *file = utils_fopen_read_binary(path);
+    if (!file) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *data = size >= 0 ? (char *) malloc((size_t) size + 1) : NULL;
+    if (data) {
+        size_t n = fread(data, 1, (size_t) size, file);
+        data[n] = '\0';
+    }
+    fclose(file);
+    return data;
+}
+
+// Copy the string value of "key" found between start and end
+static bool json_find_string(const char *start, const char *end, const char *key, char *value, size_t size) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": \"", key);
+    const char *p = strstr(start, pattern);
+    if (!p || p >= end) {
+        return false;
+    }
+
+    p += strlen(pattern);
+    size_t n = 0;
+    while (*p && *p != '"' && n + 1 < size) {
+        if (*p == '\\' && p[1]) {
+            p++;
+        }
+        value[n++] = *p++;
+    }
+    value[n] = '\0';
+    return true;
+}
+
+static bool json_find_number(const char *start, const char *end, const char *key, double *value) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+    const char *p = strstr(start, pattern);
+    if (!p || p >= end) {
+        return false;
+    }
+    *value = strtod(p + strlen(pattern), NULL);
+    return true;
+}
+
+// Compare results against a report written earlier by this runner.
+// Returns the number of regressions, or -1 if the baseline can't be read.
+static int compare_baseline(const CorpusOptions *options, const CorpusResult *results, int n_results) {
+    char *baseline = read_file(options->baseline_path);
+    if (!baseline) {
+        printf("Error: Could not read baseline: %s\n", options->baseline_path);
+        return -1;
+    }
+
+    printf("\n=== Baseline comparison (%s) ===\n", options->baseline_path);
+    int regressions = 0;
+    for (int r = 0; r < n_results; r++) {
+        const CorpusResult *result = &results[r];
+        bool found = false;
+
+        for (const char *p = strstr(baseline, "{\"model\": "); p && !found; p = strstr(p + 1, "{\"model\": ")) {
+            const char *end = strstr(p, "\"files\"");
+            if (!end) {
+                break;
+            }
+
+            char model[256], profile[64];
+            double wer, cer, rtf;
+            if (!json_find_string(p, end, "model", model, sizeof(model)) ||
+                !json_find_string(p, end, "profile", profile, sizeof(profile)) ||
+                strcmp(model, result->model) != 0 || strcmp(profile, result->profile) != 0 ||
+                !json_find_number(p, end, "wer", &wer) || !json_find_number(p, end, "cer", &cer) ||
+                !json_find_number(p, end, "rtf", &rtf)) {
+                continue;
+            }
+            found = true;
+
+            bool wer_bad = result->wer - wer > options->max_wer_increase;
+            bool cer_bad = result->cer - cer > options->max_cer_increase;
+            bool rtf_bad = rtf > 0.0 && result->rtf > rtf * (1.0 + options->max_rtf_increase);
+            printf("%s [%s]: WER %.2f%% -> %.2f%%%s, CER %.2f%% -> %.2f%%%s, RTF %.3f -> %.3f%s\n", result->model,
+                   result->profile, wer * 100.0, result->wer * 100.0, wer_bad ? " REGRESSED" : "", cer * 100.0,
+                   result->cer * 100.0, cer_bad ? " REGRESSED" : "", rtf, result->rtf, rtf_bad ? " REGRESSED" : "");
+            if (wer_bad || cer_bad || rtf_bad) {
+                regressions++;
+            }
+        }
+
+        if (!found) {
+            printf("%s [%s]: not in baseline\n", result->model, result->profile);
+        }
+    }
+
+    free(baseline);
+    return regressions;
+}
+
+int corpus_run(const CorpusOptions *options) {
+    int n_clips = 0;
+    CorpusClip *clips = load_manifest(options->manifest_path, &n_clips);
+    if (!clips) {
+        return 1;
+    }
+
+    int n_profiles = options->n_profiles > 0 ? options->n_profiles : 1;
+    Profile *profiles = (Profile *) calloc((size_t) n_profiles, sizeof(Profile));
+    int n_results = options->n_models * n_profiles;
+    CorpusResult *results = (CorpusResult *) calloc((size_t) n_results, sizeof(CorpusResult));
+    if (!profiles || !results) {
+        free(profiles);
+        free(results);
+        free_clips(clips, n_clips);
+        return 1;
+    }
+
+    for (int p = 0; p < options->n_profiles; p++) {
+        if (!parse_profile(options->profiles[p], &profiles[p])) {
+            printf("Error: Invalid profile \"%s\" (expected name:key=value,key=value)\n", options->profiles[p]);
+            free(profiles);
+            free(results);
+            free_clips(clips, n_clips);
+            return 1;
+        }
+    }
+    if (options->n_profiles == 0) {
+        snprintf(profiles[0].name, sizeof(profiles[0].name), "default");
+    }
+
+    printf("=== Corpus: %s (%d clips) ===\n", options->manifest_path, n_clips);
+
+    bool errors = false;
+    int r = 0;
+    for (int m = 0; m < options->n_models; m++) {
+        for (int p = 0; p < n_profiles; p++, r++) {
+            CorpusResult *result = &results[r];
+            snprintf(result->model, sizeof(result->model), "%s", file_name(options->models[m]));
+            snprintf(result->profile, sizeof(result->profile), "%s", profiles[p].name);
+            printf("\n--- %s [%s] ---\n", result->model, result->profile);
+
+            // Profile overrides must be in place before the load for init-time settings
+            char *saved[MAX_OVERRIDES];
+            apply_profile(&profiles[p], saved);
+
+            if (transcription_init(options->models[m]) != 0) {
+                printf("Error: Failed to load model: %s\n", options->models[m]);
+                result->n_clips = n_clips;
+                result->n_failed = n_clips;
+                result->clips = (ClipResult *) calloc((size_t) n_clips, sizeof(ClipResult));
+                for (int i = 0; result->clips && i < n_clips; i++) {
+                    result->clips[i].failed = true;
+                }
+                errors = true;
+            } else {
+                const char *language = preferences_get_string("language");
+                transcription_set_language(language && language[0] ? language : "en");
+                if (!run_clips(clips, n_clips, result) || result->n_failed > 0) {
+                    errors = true;
+                }
+                transcription_cleanup();
+            }
+
+            restore_profile(&profiles[p], saved);
+
+            printf("=> WER %.2f%%  CER %.2f%%  RTF %.3f  p50 %.0f ms  p95 %.0f ms  (%d/%d clips)\n",
+                   result->wer * 100.0, result->cer * 100.0, result->rtf, result->p50_ms, result->p95_ms,
+                   result->n_clips - result->n_failed, result->n_clips);
+        }
+    }
+
+    if (options->report_path && !write_report(options->report_path, options->manifest_path, clips, results,
+                                              n_results)) {
+        errors = true;
+    }
+
+    int regressions = 0;
+    if (options->baseline_path) {
+        regressions = compare_baseline(options, results, n_results);
+        if (regressions < 0) {
+            errors = true;
+        } else if (regressions > 0) {
+            printf("❌ %d result(s) regressed past the thresholds\n", regressions);
+        } else {
+            printf("✅ No regressions\n");
+        }
+    }
+
+    for (int i = 0; i < n_results; i++) {
+        for (int c = 0; results[i].clips && c < results[i].n_clips; c++) {
+            free(results[i].clips[c].hypothesis);
+        }
+        free(results[i].clips);
+    }
+    free(results);
+    free(profiles);
+    free_clips(clips, n_clips);
+
+    if (errors) {
+        return 1;
+    }
+    return regressions > 0 ? 2 : 0;
+}
@@ -0,0 +1,40 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <stdbool.h>
+
+// Regression corpus runner for the transcribe tool - transcribes every clip in
+// a manifest with each model and settings profile and reports WER/CER next to
+// latency and RTF, optionally checked against a stored baseline report.
+//
+// Manifest: one clip per line, "<audio path><TAB><reference transcript>".
+// Relative paths are resolved against the manifest's directory; blank lines
+// and lines starting with '#' are ignored.
+//
+// Profile: "name" or "name:key=value,key=value" - preference overrides
+// applied on top of the user's settings while that profile runs.
+
+typedef struct {
+    const char *manifest_path;
+    const char **models;
+    int n_models;
+    const char **profiles; // NULL/0 runs a single "default" profile
+    int n_profiles;
+    const char *report_path;   // JSON report to write, or NULL
+    const char *baseline_path; // Earlier report to compare against, or NULL
+    double max_wer_increase;   // Absolute, e.g. 0.01 for one percentage point
+    double max_cer_increase;
+    double max_rtf_increase; // Relative, e.g. 0.10 for 10% slower
+} CorpusOptions;
+
+// Returns 0 if everything ran without regressions, 1 on errors,
+// 2 if a result regressed past the baseline thresholds
+int corpus_run(const CorpusOptions *options);
+
+// Word and character edit distances between a hypothesis and a reference
+// after normalization (case, punctuation, whitespace). The reference length
+// in words/characters is stored in ref_length.
+int corpus_word_errors(const char *hypothesis, const char *reference, int *ref_length);
+int corpus_char_errors(const char *hypothesis, const char *reference, int *ref_length);
+
+#endif // CORPUS_H
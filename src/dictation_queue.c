@@ -0,0 +1,172 @@
+#include "dictation_queue.h"
+#include "audio.h"
+#include "logging.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    utils_thread_t *thread;
+    utils_mutex_t *mutex;
+    utils_cond_t *wakeup; // Signalled when a clip is queued or the worker should stop
+    bool running; // Atomic access required
+    dictation_job_fn handler;
+
+    // Ring of pending clips, guarded by mutex
+    DictationJob *jobs;
+    int capacity;
+    int head;
+    int count;
+    bool busy; // A clip has been taken off the ring and is being handled
+} DictationQueue;
+
+static DictationQueue g_queue = {0};
+
+// Sleep until a clip is queued; returns false once the worker should stop
+static bool pop_job(DictationJob *job) {
+    bool found = false;
+
+    utils_mutex_lock(g_queue.mutex);
+    while (g_queue.count == 0 && utils_atomic_read_bool(&g_queue.running)) {
+        utils_cond_wait(g_queue.wakeup, g_queue.mutex);
+    }
+    if (g_queue.count > 0 && utils_atomic_read_bool(&g_queue.running)) {
+        *job = g_queue.jobs[g_queue.head];
+        g_queue.head = (g_queue.head + 1) % g_queue.capacity;
+        g_queue.count--;
+        g_queue.busy = true;
+        found = true;
+    }
+    utils_mutex_unlock(g_queue.mutex);
+
+    return found;
+}
+
+static void *queue_worker(void *arg) {
+    (void) arg;
+
+    DictationJob job;
+    while (pop_job(&job)) {
+        g_queue.handler(&job);
+
+        utils_mutex_lock(g_queue.mutex);
+        g_queue.busy = false;
+        utils_mutex_unlock(g_queue.mutex);
+    }
+
+    return NULL;
+}
+
+static void discard_job(DictationJob *job) {
+    audio_recorder_release_samples(job->samples);
+    streaming_session_free(job->session);
+    mel_spectrogram_free(job->mel);
+    vad_timeline_free(job->vad);
+}
+
+bool dictation_queue_init(int capacity, dictation_job_fn handler) {
+    if (g_queue.thread) {
+        return true;
+    }
+    if (!handler) {
+        return false;
+    }
+    if (capacity < 1) {
+        capacity = 1;
+    }
+
+    g_queue.handler = handler;
+    g_queue.capacity = capacity;
+    g_queue.jobs = (DictationJob *) calloc(capacity, sizeof(DictationJob));
+    g_queue.mutex = utils_mutex_create();
+    g_queue.wakeup = utils_cond_create();
+    if (!g_queue.jobs || !g_queue.mutex || !g_queue.wakeup) {
+        log_error("Failed to allocate transcription queue");
+        dictation_queue_cleanup();
+        g_queue.handler = handler;// Clips are still handled inline
+        return false;
+    }
+
+    utils_atomic_write_bool(&g_queue.running, true);
+    g_queue.thread = utils_thread_create(queue_worker, NULL);
+    if (!g_queue.thread) {
+        log_error("Failed to start transcription worker thread");
+        dictation_queue_cleanup();
+        g_queue.handler = handler;// Clips are still handled inline
+        return false;
+    }
+
+    log_info("🧵 Transcription worker started (queue of %d recordings)", capacity);
+    return true;
+}
+
+bool dictation_queue_push(const DictationJob *job) {
+    if (!job) {
+        return false;
+    }
+
+    if (!g_queue.thread) {
+        // No worker; transcribe right here as before
+        if (g_queue.handler) {
+            DictationJob inline_job = *job;
+            g_queue.handler(&inline_job);
+            return true;
+        }
+        return false;
+    }
+
+    utils_mutex_lock(g_queue.mutex);
+    bool queued = g_queue.count < g_queue.capacity;
+    if (queued) {
+        g_queue.jobs[(g_queue.head + g_queue.count) % g_queue.capacity] = *job;
+        g_queue.count++;
+    }
+    int pending = g_queue.count + (g_queue.busy ? 1 : 0);
+    utils_mutex_unlock(g_queue.mutex);
+    if (queued) {
+        utils_cond_signal(g_queue.wakeup);
+    }
+
+    if (queued && pending > 1) {
+        log_info("🧵 Recording queued behind %d others", pending - 1);
+    }
+    return queued;
+}
+
+int dictation_queue_pending(void) {
+    if (!g_queue.mutex) {
+        return 0;
+    }
+
+    utils_mutex_lock(g_queue.mutex);
+    int pending = g_queue.count + (g_queue.busy ? 1 : 0);
+    utils_mutex_unlock(g_queue.mutex);
+
+    return pending;
+}
+
+void dictation_queue_cleanup(void) {
+    if (g_queue.thread) {
+        utils_mutex_lock(g_queue.mutex);
+        utils_atomic_write_bool(&g_queue.running, false);
+        utils_mutex_unlock(g_queue.mutex);
+        utils_cond_broadcast(g_queue.wakeup);
+        utils_thread_join(g_queue.thread);
+    }
+
+    if (g_queue.count > 0) {
+        log_info("Dropping %d queued recordings on shutdown", g_queue.count);
+    }
+    while (g_queue.count > 0) {
+        discard_job(&g_queue.jobs[g_queue.head]);
+        g_queue.head = (g_queue.head + 1) % g_queue.capacity;
+        g_queue.count--;
+    }
+
+    free(g_queue.jobs);
+    if (g_queue.mutex) {
+        utils_mutex_destroy(g_queue.mutex);
+    }
+    utils_cond_destroy(g_queue.wakeup);
+    memset(&g_queue, 0, sizeof(g_queue));
+}
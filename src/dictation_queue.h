@@ -0,0 +1,39 @@
+#ifndef DICTATION_QUEUE_H
+#define DICTATION_QUEUE_H
+
+#include <stdbool.h>
+#include "mel_stream.h"
+#include "streaming.h"
+#include "vad.h"
+
+// Transcription worker - recorded clips are queued by the key handlers and
+// transcribed and pasted one at a time, in order, on a dedicated thread, so
+// key events keep flowing while whisper runs.
+
+typedef struct {
+    float *samples;             // From audio_recorder_take_samples(); released by the handler
+    int n_samples;
+    VadTimeline *vad;           // Capture VAD timeline to reduce the samples with first, or NULL
+    StreamingSession *session;  // Detached streaming session, or NULL
+    MelSpectrogram *mel;        // Spectrogram computed while recording, or NULL; freed by the handler
+    double stop_time;           // utils_now() when the recording was stopped
+} DictationJob;
+
+typedef void (*dictation_job_fn)(DictationJob *job);
+
+// Start the worker with room for capacity pending clips
+// Returns true on success, false on failure
+bool dictation_queue_init(int capacity, dictation_job_fn handler);
+
+// Queue a clip; the queue takes ownership of its samples, session, mel and VAD timeline.
+// Without a running worker the clip is handled on the calling thread.
+// Returns false if the queue is full; the caller keeps ownership then.
+bool dictation_queue_push(const DictationJob *job);
+
+// Number of clips waiting or being transcribed
+int dictation_queue_pending(void);
+
+// Finish the clip in progress, drop the rest and stop the worker
+void dictation_queue_cleanup(void);
+
+#endif // DICTATION_QUEUE_H
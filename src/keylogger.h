@@ -39,4 +39,12 @@ void keylogger_set_combination(const KeyCombination *combo);
 // Get the default FN key combination
 KeyCombination keylogger_get_fn_combination(void);
 
+// Keys the user has pressed since startup, without the keystrokes the app
+// sends itself; compare two readings to tell whether the user typed between them
+int keylogger_get_keystroke_count(void);
+
+// macOS: user data the app stamps on the keyboard events it posts, so the
+// keylogger can tell them apart from the user's own keystrokes
+#define KEYLOGGER_SYNTHETIC_EVENT_TAG 0x59414B45
+
 #endif// KEYLOGGER_H
\ No newline at end of file
@@ -128,6 +128,56 @@ void clipboard_paste(void) {
     pending_text = NULL;
 }
 
+// wtype and ydotool take one key per argument, so long runs go in batches
+#define BACKSPACE_BATCH 64
+
+void clipboard_backspace(int count) {
+    char cmd[1024];
+    int ret = -1;
+
+    if (!detect_wayland()) {
+        if (command_exists("xdotool")) {
+            snprintf(cmd, sizeof(cmd), "xdotool key --clearmodifiers --repeat %d BackSpace 2>/dev/null", count);
+            ret = count > 0 ? system(cmd) : 0;
+        }
+    } else {
+        int use_wtype = command_exists("wtype");
+        const char *tool = use_wtype ? "wtype" : (command_exists("ydotool") ? "ydotool key" : NULL);
+        // ydotool uses Linux input event codes (14 is KEY_BACKSPACE)
+        const char *key = use_wtype ? " -k BackSpace" : " 14:1 14:0";
+        ret = tool ? 0 : -1;
+        for (int done = 0; tool && done < count && ret == 0; done += BACKSPACE_BATCH) {
+            int length = snprintf(cmd, sizeof(cmd), "%s", tool);
+            for (int i = done; i < count && i < done + BACKSPACE_BATCH; i++) {
+                length += snprintf(cmd + length, sizeof(cmd) - length, "%s", key);
+            }
+            snprintf(cmd + length, sizeof(cmd) - length, " 2>/dev/null");
+            ret = system(cmd);
+        }
+    }
+
+    if (ret != 0) {
+        log_error("Failed to send backspaces - install xdotool (X11) or wtype (Wayland)");
+    }
+}
+
+unsigned long long clipboard_focused_window(void) {
+    // Wayland does not tell clients which window has focus
+    if (detect_wayland() || !command_exists("xdotool")) {
+        return 0;
+    }
+
+    unsigned long long window = 0;
+    FILE *pipe = popen("xdotool getwindowfocus 2>/dev/null", "r");
+    if (pipe) {
+        if (fscanf(pipe, "%llu", &window) != 1) {
+            window = 0;
+        }
+        pclose(pipe);
+    }
+    return window;
+}
+
 void clipboard_cleanup(void) {
     free(pending_text);
     pending_text = NULL;
@@ -45,6 +45,9 @@ typedef struct {
 } KeyloggerContext;
 
 static KeyloggerContext *g_keylogger = NULL;
+// Key presses of the user: xdotool and wtype keystrokes never reach evdev,
+// and the device ydotool types through is left out
+static volatile int g_keystrokes = 0;
 
 static bool is_key_pressed(uint32_t code) {
     if (!g_keylogger) return false;
@@ -147,6 +150,9 @@ static void process_key_event(struct input_event *ev, const char *keyboard_name)
     // Debug: show key events
     const char *key_name = libevdev_event_code_get_name(EV_KEY, ev->code);
     if (keyDown) {
+        if (!strstr(keyboard_name, "ydotool")) {
+            g_keystrokes++;
+        }
         log_debug("[%s] KEY DOWN: %s (code=%d/0x%02X)", 
             keyboard_name, key_name ? key_name : "UNKNOWN", ev->code, ev->code);
         add_pressed_key(ev->code);
@@ -350,6 +356,10 @@ void keylogger_set_combination(const KeyCombination *combo) {
     }
 }
 
+int keylogger_get_keystroke_count(void) {
+    return g_keystrokes;
+}
+
 KeyCombination keylogger_get_fn_combination(void) {
     // Linux doesn't have FN key like macOS. Use Right Ctrl as default.
     // KEY_RIGHTCTRL = 97 in linux/input-event-codes.h
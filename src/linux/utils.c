@@ -1,12 +1,15 @@
 #include "utils.h"
 #include "logging.h"
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <pthread.h>
 #include <stdatomic.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <time.h>
@@ -180,6 +183,51 @@ FILE *utils_fopen_append(const char *path) {
     return fopen(path, "a");
 }
 
+const void *utils_map_file(const char *path, size_t *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    void *data = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            data = NULL;
+        } else {
+            *size = (size_t) st.st_size;
+        }
+    }
+    close(fd); // The mapping stays valid
+    return data;
+}
+
+void utils_unmap_file(const void *data, size_t size) {
+    if (data) {
+        munmap((void *) data, size);
+    }
+}
+
+bool utils_list_dir(const char *dir, utils_dir_fn fn, void *user_data) {
+    DIR *handle = opendir(dir);
+    if (!handle) {
+        return false;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(handle)) != NULL) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        struct stat st;
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+            fn(path, user_data);
+        }
+    }
+    closedir(handle);
+    return true;
+}
+
 char *utils_strdup(const char *str) {
     return str ? strdup(str) : NULL;
 }
@@ -237,10 +285,71 @@ void utils_mutex_unlock(utils_mutex_t *mutex) {
     }
 }
 
+struct utils_cond {
+    pthread_cond_t cond;
+};
+
+utils_cond_t *utils_cond_create(void) {
+    utils_cond_t *c = malloc(sizeof(utils_cond_t));
+    if (c && pthread_cond_init(&c->cond, NULL) != 0) {
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+void utils_cond_destroy(utils_cond_t *cond) {
+    if (cond) {
+        pthread_cond_destroy(&cond->cond);
+        free(cond);
+    }
+}
+
+void utils_cond_wait(utils_cond_t *cond, utils_mutex_t *mutex) {
+    if (cond && mutex) {
+        pthread_cond_wait(&cond->cond, &mutex->mutex);
+    }
+}
+
+void utils_cond_signal(utils_cond_t *cond) {
+    if (cond) {
+        pthread_cond_signal(&cond->cond);
+    }
+}
+
+void utils_cond_broadcast(utils_cond_t *cond) {
+    if (cond) {
+        pthread_cond_broadcast(&cond->cond);
+    }
+}
+
 void *utils_thread_id(void) {
     return (void *)(uintptr_t)pthread_self();
 }
 
+// Joinable threads
+struct utils_thread {
+    pthread_t thread;
+};
+
+utils_thread_t *utils_thread_create(utils_thread_fn fn, void *arg) {
+    utils_thread_t *t = malloc(sizeof(utils_thread_t));
+    if (!t) return NULL;
+
+    if (pthread_create(&t->thread, NULL, fn, arg) != 0) {
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+void utils_thread_join(utils_thread_t *thread) {
+    if (thread) {
+        pthread_join(thread->thread, NULL);
+        free(thread);
+    }
+}
+
 // Async execution
 typedef struct {
     async_work_fn work;
@@ -293,3 +402,135 @@ void utils_execute_main_thread(int delay_ms, delay_callback_fn callback, void *a
         callback(arg);
     }
 }
+
+#define MAX_CPUS 1024
+
+// Read a small sysfs file into buf; returns false if it doesn't exist
+static bool read_sysfs(const char *path, char *buf, size_t size) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    size_t len = fread(buf, 1, size - 1, file);
+    fclose(file);
+    buf[len] = '\0';
+    return len > 0;
+}
+
+// Parse a cpu list like "0-7,16-23" into a membership array
+static void parse_cpu_list(const char *list, bool *cpus, int max_cpus) {
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        long last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+        }
+        for (long cpu = first; cpu <= last && cpu < max_cpus; cpu++) {
+            if (cpu >= 0) {
+                cpus[cpu] = true;
+            }
+        }
+        p = (*end == ',') ? end + 1 : end;
+        if (*end != ',') {
+            break;
+        }
+    }
+}
+
+bool utils_get_cpu_info(utils_cpu_info_t *info) {
+    if (!info) {
+        return false;
+    }
+
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    info->logical_cpus = online > 0 ? (int) online : 1;
+    info->physical_cores = info->logical_cpus;
+    info->performance_cores = info->logical_cpus;
+    snprintf(info->name, sizeof(info->name), "unknown");
+
+    // CPU model name
+    FILE *cpuinfo = fopen("/proc/cpuinfo", "r");
+    if (cpuinfo) {
+        char line[256];
+        while (fgets(line, sizeof(line), cpuinfo)) {
+            if (strncmp(line, "model name", 10) == 0 || strncmp(line, "Hardware", 8) == 0) {
+                char *value = strchr(line, ':');
+                if (value) {
+                    value++;
+                    while (*value == ' ' || *value == '\t') value++;
+                    value[strcspn(value, "\n")] = '\0';
+                    snprintf(info->name, sizeof(info->name), "%s", value);
+                    break;
+                }
+            }
+        }
+        fclose(cpuinfo);
+    }
+
+    // Intel hybrid CPUs list their P-cores here; ARM big.LITTLE reports per-cpu capacity
+    bool perf_cpus[MAX_CPUS];
+    char buf[1024];
+    memset(perf_cpus, 0, sizeof(perf_cpus));
+    bool have_core_list = read_sysfs("/sys/devices/cpu_core/cpus", buf, sizeof(buf));
+    if (have_core_list) {
+        parse_cpu_list(buf, perf_cpus, MAX_CPUS);
+    }
+
+    int n_cpus = info->logical_cpus < MAX_CPUS ? info->logical_cpus : MAX_CPUS;
+    int capacity[MAX_CPUS];
+    int max_capacity = 0;
+    for (int cpu = 0; cpu < n_cpus; cpu++) {
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpu_capacity", cpu);
+        capacity[cpu] = read_sysfs(path, buf, sizeof(buf)) ? atoi(buf) : 0;
+        if (capacity[cpu] > max_capacity) max_capacity = capacity[cpu];
+    }
+
+    // Count distinct (package, core) pairs overall and among the performance cpus
+    long core_keys[MAX_CPUS];
+    bool core_is_perf[MAX_CPUS];
+    int n_cores = 0;
+    bool topology_found = false;
+    for (int cpu = 0; cpu < n_cpus; cpu++) {
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        if (!read_sysfs(path, buf, sizeof(buf))) {
+            continue;
+        }
+        long core_id = atol(buf);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+        long package_id = read_sysfs(path, buf, sizeof(buf)) ? atol(buf) : 0;
+        long key = package_id * 65536 + core_id;
+        topology_found = true;
+
+        bool is_perf = have_core_list ? perf_cpus[cpu] : (max_capacity == 0 || capacity[cpu] == max_capacity);
+
+        int i = 0;
+        while (i < n_cores && core_keys[i] != key) i++;
+        if (i == n_cores) {
+            core_keys[n_cores] = key;
+            core_is_perf[n_cores] = is_perf;
+            n_cores++;
+        } else if (is_perf) {
+            core_is_perf[i] = true;
+        }
+    }
+
+    if (!topology_found) {
+        return false;
+    }
+
+    int n_perf = 0;
+    for (int i = 0; i < n_cores; i++) {
+        if (core_is_perf[i]) n_perf++;
+    }
+    info->physical_cores = n_cores;
+    info->performance_cores = n_perf > 0 ? n_perf : n_cores;
+    return true;
+}
@@ -1,4 +1,5 @@
 #include "../clipboard.h"
+#include "../keylogger.h"
 #include "../logging.h"
 #import <Carbon/Carbon.h>
 #import <Cocoa/Cocoa.h>
@@ -15,6 +16,7 @@ void clipboard_copy(const char *text) {
 void clipboard_paste(void) {
     @autoreleasepool {
         CGEventSourceRef source = CGEventSourceCreate(kCGEventSourceStateHIDSystemState);
+        CGEventSourceSetUserData(source, KEYLOGGER_SYNTHETIC_EVENT_TAG);
 
         CGEventRef cmdDown = CGEventCreateKeyboardEvent(source, kVK_Command, true);
         CGEventRef vDown = CGEventCreateKeyboardEvent(source, kVK_ANSI_V, true);
@@ -35,4 +37,34 @@ void clipboard_paste(void) {
         CFRelease(cmdUp);
         CFRelease(source);
     }
-}
\ No newline at end of file
+}
+
+void clipboard_backspace(int count) {
+    @autoreleasepool {
+        CGEventSourceRef source = CGEventSourceCreate(kCGEventSourceStateHIDSystemState);
+        CGEventSourceSetUserData(source, KEYLOGGER_SYNTHETIC_EVENT_TAG);
+
+        for (int i = 0; i < count; i++) {
+            CGEventRef deleteDown = CGEventCreateKeyboardEvent(source, kVK_Delete, true);
+            CGEventRef deleteUp = CGEventCreateKeyboardEvent(source, kVK_Delete, false);
+
+            // No modifiers; a held Fn would turn this into forward delete
+            CGEventSetFlags(deleteDown, 0);
+            CGEventSetFlags(deleteUp, 0);
+
+            CGEventPost(kCGHIDEventTap, deleteDown);
+            CGEventPost(kCGHIDEventTap, deleteUp);
+
+            CFRelease(deleteDown);
+            CFRelease(deleteUp);
+        }
+        CFRelease(source);
+    }
+}
+
+unsigned long long clipboard_focused_window(void) {
+    @autoreleasepool {
+        NSRunningApplication *app = [[NSWorkspace sharedWorkspace] frontmostApplication];
+        return app ? (unsigned long long) app.processIdentifier : 0;
+    }
+}
@@ -15,6 +15,7 @@ static bool comboPressed = false;
 static bool isPaused = false;
 static CFMachPortRef eventTap = NULL;
 static CFRunLoopSourceRef runLoopSource = NULL;
+static volatile int g_keystrokes = 0;
 
 // Current key combination to monitor (default is FN key)
 // Note: kCGEventFlagMaskSecondaryFn = 0x800000
@@ -170,6 +171,11 @@ static CGEventRef CGEventCallback(CGEventTapProxy proxy, CGEventType type, CGEve
         return event;
     }
 
+    if (type == kCGEventKeyDown &&
+        CGEventGetIntegerValueField(event, kCGEventSourceUserData) != KEYLOGGER_SYNTHETIC_EVENT_TAG) {
+        g_keystrokes++;
+    }
+
     if (isPaused)
         return event;
 
@@ -334,6 +340,10 @@ void keylogger_set_combination(const KeyCombination *combo) {
     }
 }
 
+int keylogger_get_keystroke_count(void) {
+    return g_keystrokes;
+}
+
 KeyCombination keylogger_get_fn_combination(void) {
     KeyCombination fn_combo = {{0}};
     fn_combo.keys[0].code = 0; // No specific key, modifier only
@@ -5,8 +5,11 @@
 #import <AppKit/AppKit.h>
 #import <Foundation/Foundation.h>
 #import <ServiceManagement/ServiceManagement.h>
+#include <dirent.h>
+#include <fcntl.h>
 #include <pthread.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <unistd.h>
@@ -357,6 +360,51 @@ FILE *utils_fopen_append(const char *path) {
     return fopen(path, "a");
 }
 
+const void *utils_map_file(const char *path, size_t *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    void *data = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            data = NULL;
+        } else {
+            *size = (size_t) st.st_size;
+        }
+    }
+    close(fd); // The mapping stays valid
+    return data;
+}
+
+void utils_unmap_file(const void *data, size_t size) {
+    if (data) {
+        munmap((void *) data, size);
+    }
+}
+
+bool utils_list_dir(const char *dir, utils_dir_fn fn, void *user_data) {
+    DIR *handle = opendir(dir);
+    if (!handle) {
+        return false;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(handle)) != NULL) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        struct stat st;
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+            fn(path, user_data);
+        }
+    }
+    closedir(handle);
+    return true;
+}
+
 char *utils_strdup(const char *str) {
     return strdup(str);
 }
@@ -437,6 +485,96 @@ void utils_mutex_unlock(utils_mutex_t* mutex) {
     }
 }
 
+// Condition variable over the recursive mutex above; waits must hold it once
+struct utils_cond {
+    pthread_cond_t cond;
+};
+
+utils_cond_t* utils_cond_create(void) {
+    utils_cond_t* c = malloc(sizeof(utils_cond_t));
+    if (c && pthread_cond_init(&c->cond, NULL) != 0) {
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+void utils_cond_destroy(utils_cond_t* cond) {
+    if (cond) {
+        pthread_cond_destroy(&cond->cond);
+        free(cond);
+    }
+}
+
+void utils_cond_wait(utils_cond_t* cond, utils_mutex_t* mutex) {
+    if (cond && mutex) {
+        pthread_cond_wait(&cond->cond, &mutex->mutex);
+    }
+}
+
+void utils_cond_signal(utils_cond_t* cond) {
+    if (cond) {
+        pthread_cond_signal(&cond->cond);
+    }
+}
+
+void utils_cond_broadcast(utils_cond_t* cond) {
+    if (cond) {
+        pthread_cond_broadcast(&cond->cond);
+    }
+}
+
 void* utils_thread_id(void) {
     return (void*)pthread_self();
 }
+
+// Joinable thread implementation using pthread
+struct utils_thread {
+    pthread_t thread;
+};
+
+utils_thread_t* utils_thread_create(utils_thread_fn fn, void* arg) {
+    utils_thread_t* t = malloc(sizeof(utils_thread_t));
+    if (!t) return NULL;
+
+    if (pthread_create(&t->thread, NULL, fn, arg) != 0) {
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+void utils_thread_join(utils_thread_t* thread) {
+    if (thread) {
+        pthread_join(thread->thread, NULL);
+        free(thread);
+    }
+}
+
+#include <sys/sysctl.h>
+
+static int sysctl_int(const char *name, int fallback) {
+    int value = 0;
+    size_t size = sizeof(value);
+    if (sysctlbyname(name, &value, &size, NULL, 0) != 0 || value <= 0) {
+        return fallback;
+    }
+    return value;
+}
+
+bool utils_get_cpu_info(utils_cpu_info_t *info) {
+    if (!info) {
+        return false;
+    }
+
+    info->logical_cpus = sysctl_int("hw.logicalcpu", 1);
+    info->physical_cores = sysctl_int("hw.physicalcpu", info->logical_cpus);
+    // Apple silicon: perflevel0 is the performance cluster
+    info->performance_cores = sysctl_int("hw.perflevel0.physicalcpu", info->physical_cores);
+
+    size_t size = sizeof(info->name);
+    if (sysctlbyname("machdep.cpu.brand_string", info->name, &size, NULL, 0) != 0) {
+        snprintf(info->name, sizeof(info->name), "unknown");
+    }
+    return true;
+}
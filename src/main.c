@@ -9,14 +9,18 @@
 #include "app.h"
 #include "audio.h"
 #include "clipboard.h"
+#include "dictation_queue.h"
 #include "keylogger.h"
 #include "logging.h"
+#include "mel_stream.h"
 #include "menu.h"
 #include "models.h"
 #include "overlay.h"
 #include "preferences.h"
+#include "streaming.h"
 #include "transcription.h"
 #include "utils.h"
+#include "vad.h"
 
 #include "dialog.h"
 
@@ -29,6 +33,8 @@ typedef struct {
 } AppState;
 
 static AppState *g_state = NULL;
+static bool g_capture_vad = false;
+static int g_cancellations = 0; // Bumped by the key handlers whenever they stop a transcription
 
 // Forward declarations
 static void on_key_press(void *userdata);
@@ -126,7 +132,236 @@ static void handle_first_run(void) {
     }
 }
 
+// Stop the transcription in progress and let the worker know it happened
+static void cancel_transcription(void) {
+    utils_atomic_write_int(&g_cancellations, utils_atomic_read_int(&g_cancellations) + 1);
+    transcription_cancel();
+}
+
+// Decode the UTF-8 code point at text and store its length in *size
+static uint32_t utf8_decode(const unsigned char *text, int *size) {
+    int length = text[0] >= 0xF0 ? 4 : text[0] >= 0xE0 ? 3 : text[0] >= 0xC0 ? 2 : 1;
+    if (length == 1) {
+        *size = 1;
+        return text[0] < 0x80 ? text[0] : 0xFFFD;
+    }
+
+    uint32_t c = text[0] & (0x3F >> (length - 1));
+    for (int i = 1; i < length; i++) {
+        if ((text[i] & 0xC0) != 0x80) {
+            *size = i;
+            return 0xFFFD;
+        }
+        c = (c << 6) | (text[i] & 0x3F);
+    }
+    *size = length;
+    return c;
+}
+
+// Combining marks, variation selectors, emoji skin tones and the zero width
+// joiner attach to the character before them
+static bool extends_character(uint32_t c) {
+    return (c >= 0x0300 && c <= 0x036F) || (c >= 0x1AB0 && c <= 0x1AFF) || (c >= 0x1DC0 && c <= 0x1DFF) ||
+           (c >= 0x20D0 && c <= 0x20FF) || (c >= 0xFE00 && c <= 0xFE0F) || (c >= 0xFE20 && c <= 0xFE2F) ||
+           (c >= 0x1F3FB && c <= 0x1F3FF) || (c >= 0xE0100 && c <= 0xE01EF) || c == 0x200D;
+}
+
+static bool is_regional_indicator(uint32_t c) {
+    return c >= 0x1F1E6 && c <= 0x1F1FF;
+}
+
+// End of the character starting at text, as one Backspace deletes it: an
+// approximation of grapheme clusters covering combining sequences, emoji
+// joined with ZWJ, flags and CRLF line breaks
+static const char *next_character(const char *text) {
+    const unsigned char *p = (const unsigned char *) text;
+    if (!*p) {
+        return text;
+    }
+
+    int size;
+    uint32_t c = utf8_decode(p, &size);
+    p += size;
+    if (c == '\r' && *p == '\n') {
+        return (const char *) p + 1;
+    }
+
+    bool flag = is_regional_indicator(c);
+    while (*p) {
+        uint32_t next = utf8_decode(p, &size);
+        if (c != 0x200D && !extends_character(next) && !(flag && is_regional_indicator(next))) {
+            break;
+        }
+        flag = false;// A flag is a pair of regional indicators
+        c = next;
+        p += size;
+    }
+    return (const char *) p;
+}
+
+// Turn the pasted draft into the final text with as few keystrokes as the
+// cursor allows: keep the prefix they share, backspace over the rest of the
+// draft and paste the remainder of the final text
+static void correct_draft(const char *draft, const char *text) {
+    // Compare whole characters so the cut never splits one
+    size_t prefix = 0;
+    while (draft[prefix]) {
+        size_t draft_end = next_character(draft + prefix) - draft;
+        size_t text_end = next_character(text + prefix) - text;
+        if (draft_end != text_end || memcmp(draft + prefix, text + prefix, draft_end - prefix) != 0) {
+            break;
+        }
+        prefix = draft_end;
+    }
+
+    int n_deleted = 0;
+    for (const char *p = draft + prefix; *p; p = next_character(p)) {
+        n_deleted++;
+    }
+    if (n_deleted == 0 && text[prefix] == '\0') {
+        log_info("✏️  Draft confirmed by the main model");
+        return;
+    }
+
+    double correct_start = utils_now();
+    clipboard_backspace(n_deleted);
+    if (text[prefix] != '\0') {
+        clipboard_copy(text + prefix);
+        clipboard_paste();
+    }
+    log_info("✏️  Corrected draft: replaced %d characters with \"%s\" (%.0f ms)", n_deleted, text + prefix,
+             (utils_now() - correct_start) * 1000.0);
+}
+
+// Transcribe and paste one recorded clip - runs on the transcription worker
+static void transcribe_job(DictationJob *job) {
+    // Don't cover the recording indicator of a dictation that started meanwhile
+    bool show_overlay = !(g_state && utils_atomic_read_bool(&g_state->recording));
+    if (show_overlay) {
+        overlay_show("Transcribing");
+    }
+
+    double transcribe_start = utils_now();
+    int cancellations = utils_atomic_read_int(&g_cancellations);
+
+    // Reduce the clip to the speech the capture VAD found while recording
+    float *speech = NULL;
+    const float *samples = job->samples;
+    int n_samples = job->n_samples;
+    bool speech_only = false;
+    if (job->vad) {
+        speech = vad_stream_compact(job->vad, job->samples, job->n_samples, &n_samples);
+        job->vad = NULL;
+        if (speech) {
+            samples = speech;
+            speech_only = true;
+        }
+    }
+
+    // Two-pass: paste the draft model's text now and correct it once the main model is done
+    char *draft = NULL;
+    unsigned long long draft_window = 0;
+    int draft_keystrokes = 0;
+    if (!job->session && n_samples > 0 && transcription_has_draft()) {
+        // Both passes transcribe the same speech, so run VAD once for them
+        if (!speech_only) {
+            speech = transcription_extract_speech(job->samples, job->n_samples, &n_samples);
+            if (speech) {
+                samples = speech;
+                speech_only = true;
+            }
+        }
+        draft = n_samples > 0 ? transcription_process_draft(samples, n_samples, speech_only) : NULL;
+        if (utils_atomic_read_int(&g_cancellations) != cancellations) {
+            log_info("❌ Dictation cancelled during the draft");
+            free(draft);
+            free(speech);
+            if (show_overlay) {
+                overlay_hide();
+            }
+            mel_spectrogram_free(job->mel);
+            audio_recorder_release_samples(job->samples);
+            return;
+        }
+        if (draft && strlen(draft) > 0) {
+            clipboard_copy(draft);
+            clipboard_paste();
+            // Where the draft went, to tell later whether it is still safe to edit
+            draft_window = clipboard_focused_window();
+            draft_keystrokes = keylogger_get_keystroke_count();
+            log_info("✏️  Draft pasted %.0f ms after stop: \"%s\"", (utils_now() - job->stop_time) * 1000.0, draft);
+        } else {
+            free(draft);
+            draft = NULL;
+        }
+    }
+
+    char *text = NULL;
+    if (job->session) {
+        text = streaming_finish(job->session, job->samples, job->n_samples);
+    } else if (speech_only) {
+        text = n_samples > 0 ? transcription_process_speech(samples, n_samples) : utils_strdup("");
+    } else if (job->mel) {
+        text = transcription_process_mel(job->samples, job->n_samples, job->mel);
+    } else {
+        text = transcription_process(job->samples, job->n_samples, 16000);
+    }
+    double transcribe_duration = utils_now() - transcribe_start;
+    if (show_overlay && !(g_state && utils_atomic_read_bool(&g_state->recording))) {
+        overlay_hide();
+    }
+    log_info("⏱️  Full transcription pipeline took: %.0f ms", transcribe_duration * 1000.0);
+
+    // A cancelled transcription returns what it decoded so far; never paste that
+    bool cancelled = utils_atomic_read_int(&g_cancellations) != cancellations;
+
+    if (draft) {
+        // Leave the draft alone if the main pass was cut short, or while the
+        // hotkey is held (keystrokes would mix with its modifiers)
+        if (!text || cancelled) {
+            log_info("✏️  Keeping the draft: main transcription did not finish");
+        } else if (g_state && utils_atomic_read_bool(&g_state->recording)) {
+            log_info("✏️  Keeping the draft: a new recording is in progress");
+        } else if (clipboard_focused_window() != draft_window) {
+            log_info("✏️  Keeping the draft: focus moved to another window");
+        } else if (keylogger_get_keystroke_count() != draft_keystrokes) {
+            log_info("✏️  Keeping the draft: keys were typed since it was pasted");
+        } else {
+            correct_draft(draft, text);
+            log_info("⏱️  Total time from stop to correction: %.0f ms", (utils_now() - job->stop_time) * 1000.0);
+        }
+        free(draft);
+        free(text);
+    } else if (cancelled) {
+        log_info("❌ Dictation cancelled, dropping its partial text");
+        free(text);
+    } else if (text && strlen(text) > 0) {
+        // Text is already cleaned and has trailing space from transcription_process
+        double clipboard_start = utils_now();
+        clipboard_copy(text);
+        clipboard_paste();
+        double clipboard_duration = utils_now() - clipboard_start;
+
+        log_info("📝 \"%s\"", text);
+        log_info("✅ Text pasted! (clipboard operations took %.0f ms)", clipboard_duration * 1000.0);
+
+        double total_time = utils_now() - job->stop_time;
+        log_info("⏱️  Total time from stop to paste: %.0f ms", total_time * 1000.0);
+
+        free(text);
+    } else {
+        log_info("⚠️  No speech detected");
+        if (text)
+            free(text);
+    }
+
+    free(speech);
+    mel_spectrogram_free(job->mel);
+    audio_recorder_release_samples(job->samples);
+}
+
 // Process recorded audio - extract from on_key_release
+// Only stops the recording and queues it; transcription runs on the worker.
 static void process_recorded_audio(double duration) {
     log_info("🔴 Recorded for %.2f seconds", duration);
     double stop_start = utils_now();
@@ -137,41 +372,39 @@ static void process_recorded_audio(double duration) {
     // Get recorded audio
     double get_samples_start = utils_now();
     int sample_count = 0;
-    float *samples = audio_recorder_get_samples(&sample_count);
+    float *samples = audio_recorder_take_samples(&sample_count);
     double get_samples_duration = utils_now() - get_samples_start;
     log_info("⏱️  Getting audio samples took: %.0f ms (%d samples)", get_samples_duration * 1000.0, sample_count);
 
-    if (samples && sample_count > 0) {
-        log_info("🧠 Starting transcription of %.2f seconds of audio...", (float) sample_count / 16000.0f);
-        overlay_show("Transcribing");
-
-        double transcribe_start = utils_now();
-        char *text = transcription_process(samples, sample_count, 16000);
-        double transcribe_duration = utils_now() - transcribe_start;
+    if (!samples || sample_count <= 0) {
+        audio_recorder_release_samples(samples);
+        streaming_cancel();
         overlay_hide();
-        log_info("⏱️  Full transcription pipeline took: %.0f ms", transcribe_duration * 1000.0);
-
-        if (text && strlen(text) > 0) {
-            // Text is already cleaned and has trailing space from transcription_process
-            double clipboard_start = utils_now();
-            clipboard_copy(text);
-            clipboard_paste();
-            double clipboard_duration = utils_now() - clipboard_start;
-
-            log_info("📝 \"%s\"", text);
-            log_info("✅ Text pasted! (clipboard operations took %.0f ms)", clipboard_duration * 1000.0);
-
-            double total_time = utils_now() - stop_start;
-            log_info("⏱️  Total time from stop to paste: %.0f ms", total_time * 1000.0);
+        return;
+    }
 
-            free(text);
-        } else {
-            log_info("⚠️  No speech detected");
-            if (text)
-                free(text);
-        }
+    log_info("🧠 Starting transcription of %.2f seconds of audio...", (float) sample_count / 16000.0f);
+
+    DictationJob job = {0};
+    job.samples = samples;
+    job.n_samples = sample_count;
+    job.stop_time = stop_start;
+    job.session = streaming_stop();
+    if (!job.session && vad_stream_is_ready() && preferences_get_bool("vad_enabled", true)) {
+        // Detach the speech timeline before the next recording resets it; the worker compacts
+        job.vad = vad_stream_take();
+    } else if (!job.session) {
+        // Most of the spectrogram was computed while recording; finish the tail
+        job.mel = mel_stream_finish(sample_count);
+    }
 
-        free(samples);
+    overlay_hide();
+    if (!dictation_queue_push(&job)) {
+        log_error("Transcription queue full, dropping %.2f seconds of audio", (float) sample_count / 16000.0f);
+        streaming_session_free(job.session);
+        mel_spectrogram_free(job.mel);
+        vad_timeline_free(job.vad);
+        audio_recorder_release_samples(samples);
     }
 }
 
@@ -179,14 +412,33 @@ static void on_key_press(void *userdata) {
     AppState *state = (AppState *) userdata;
 
     if (!state->recording) {
-        state->recording = true;
+        utils_atomic_write_bool(&state->recording, true);
         state->recording_start_time = utils_get_time();
 
+        // Optionally give the new dictation priority over one still transcribing
+        if (preferences_get_bool("preempt_transcription", false) && dictation_queue_pending() > 0) {
+            log_info("⏹️  New recording preempts the running transcription");
+            cancel_transcription();
+        }
+
+        // Reset the speech timeline before the pre-roll is flushed into the recording
+        vad_stream_begin();
+
+        // The spectrogram only helps when whisper gets the recording unchanged
+        bool unchanged =
+            !preferences_get_bool("vad_enabled", true) && !preferences_get_bool("streaming_enabled", false);
+        mel_stream_begin(unchanged ? models_get_n_mels() : 0);
+
         if (audio_recorder_start() == 0) {
             overlay_show("Recording");
+
+            // Optionally decode while the key is held so release only finalizes the tail
+            if (preferences_get_bool("streaming_enabled", false)) {
+                streaming_start();
+            }
         } else {
             log_error("Failed to start recording");
-            state->recording = false;
+            utils_atomic_write_bool(&state->recording, false);
         }
     }
 }
@@ -195,13 +447,14 @@ static void on_key_release(void *userdata) {
     AppState *state = (AppState *) userdata;
 
     if (state->recording) {
-        state->recording = false;
+        utils_atomic_write_bool(&state->recording, false);
         double duration = utils_get_time() - state->recording_start_time;
 
         // Minimum recording duration check
         if (duration < MIN_RECORDING_DURATION) {
             log_info("⚠️  Recording too brief (%.2f seconds), ignoring", duration);
             audio_recorder_stop();
+            streaming_cancel();
             overlay_hide();
             return;
         }
@@ -215,15 +468,27 @@ static void on_key_cancel(void *userdata) {
     AppState *state = (AppState *) userdata;
 
     if (state->recording) {
-        state->recording = false;
+        utils_atomic_write_bool(&state->recording, false);
         log_info("❌ Recording cancelled - additional key pressed");
 
         // Stop recording and clean up
         audio_recorder_stop();
+        streaming_cancel();
         overlay_hide();
 
-        // No transcription or text insertion
+        // No transcription or text insertion - and stop the one still running, if any
+        if (dictation_queue_pending() > 0) {
+            cancel_transcription();
+        }
+    }
+}
+
+// Recorded samples go to whichever capture-path consumers are running
+static void on_samples(const float *samples, int n_samples) {
+    if (g_capture_vad) {
+        vad_stream_feed(samples, n_samples);
     }
+    mel_stream_feed(samples, n_samples);
 }
 
 // Called when app is ready - for both CLI and tray apps
@@ -235,6 +500,23 @@ static void on_app_ready(void) {
         return; // Model loading failed and quit was called
     }
 
+    // Transcription runs on its own thread so key handling never waits for whisper
+    dictation_queue_init(preferences_get_int("transcription_queue_size", 4), transcribe_job);
+
+    // Optionally run VAD on the capture path so release only decodes speech
+    if (preferences_get_bool("vad_enabled", true) && preferences_get_bool("vad_during_capture", false)) {
+        g_capture_vad = vad_stream_init(models_get_vad_path());
+        if (!g_capture_vad) {
+            log_error("Capture VAD unavailable, falling back to VAD at transcription time");
+        }
+    }
+
+    // Compute the spectrogram while recording so release starts at the encoder
+    bool incremental_mel = preferences_get_bool("incremental_mel", true) && mel_stream_init();
+    if (g_capture_vad || incremental_mel) {
+        audio_recorder_set_samples_callback(on_samples);
+    }
+
     // Step 2: Setup menu system
     if (!setup_menu_if_needed()) {
         return; // Menu setup failed and quit was called
@@ -294,7 +576,10 @@ static void cleanup_all(void) {
     if (!app_is_console()) {
         menu_cleanup();
     }
+    dictation_queue_cleanup();
     audio_recorder_cleanup();
+    vad_stream_cleanup();
+    mel_stream_cleanup();
     transcription_cleanup();
     overlay_cleanup();
     app_cleanup();
@@ -350,6 +635,18 @@ int app_main(int argc, char **argv, bool is_console) {
         return 1;
     }
 
+    // Optional compact int16 storage for long dictations on memory-constrained machines
+    if (preferences_get_bool("compact_audio_buffer", false)) {
+        audio_recorder_set_compact_storage(true);
+    }
+
+    // Optional always-on capture so the first syllable is never clipped
+    if (preferences_get_bool("always_on_capture", false)) {
+        if (audio_recorder_set_preroll(preferences_get_int("preroll_ms", 300)) != 0) {
+            log_error("Failed to enable always-on capture, starting device on key press instead");
+        }
+    }
+
     AppState state = {0};
     g_state = &state;
 
@@ -0,0 +1,400 @@
+extern "C" {
+#include "mel_stream.h"
+#include "logging.h"
+#include "utils.h"
+}
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// whisper's spectrogram: 25 ms Hann windows every 10 ms at 16 kHz, with the
+// first window centered on the first sample (reflected padding) and 30 s of
+// silence appended to every clip
+#define MEL_SAMPLE_RATE 16000
+#define MEL_N_FFT 400
+#define MEL_HOP 160
+#define MEL_N_BINS (MEL_N_FFT / 2 + 1)
+#define MEL_HALF_WINDOW (MEL_N_FFT / 2)
+#define MEL_PAD_SAMPLES (MEL_SAMPLE_RATE * 30)
+// Value of an all-silent frame before normalization, log10(1e-10)
+#define MEL_SILENT_FRAME -10.0f
+
+static float hann[MEL_N_FFT];// Periodic
+static float sin_table[MEL_N_FFT];
+static float cos_table[MEL_N_FFT];
+static std::vector<float> filters;// n_mel rows of MEL_N_BINS, as in whisper's model files
+static int filters_n_mel = 0;
+
+// Recording state shared by the feeding, worker and finishing threads
+static std::mutex state_mutex;
+static std::condition_variable state_cv;
+static std::vector<float> head;   // First samples of the recording, for the reflected padding
+static std::vector<float> pending;// Samples still needed by upcoming frames
+static long long pending_start = 0;// Recording position of pending[0]
+static long long n_fed = 0;
+static std::vector<float> frames;// log10 mel energies, n_mel per frame
+static int n_mel = 0;            // 0 while not tracking a recording
+static double compute_seconds = 0.0;
+static bool worker_busy = false;
+static bool worker_stop = false;
+static bool running = false;
+static int generation = 0;// Bumped per recording so stale frames are dropped
+static std::thread worker;
+
+static void dft(const float *in, int n, float *out) {
+	const int step = MEL_N_FFT / n;
+	for (int k = 0; k < n; k++) {
+		float re = 0.0f;
+		float im = 0.0f;
+		for (int j = 0; j < n; j++) {
+			const int index = (k * j * step) % MEL_N_FFT;
+			re += in[j] * cos_table[index];
+			im -= in[j] * sin_table[index];
+		}
+		out[2 * k + 0] = re;
+		out[2 * k + 1] = im;
+	}
+}
+
+// Recursive radix-2 FFT of real input down to the odd factor (25 for 400),
+// which gets a plain DFT. Output is interleaved complex.
+static void fft(const float *in, int n, float *out) {
+	if (n == 1) {
+		out[0] = in[0];
+		out[1] = 0.0f;
+		return;
+	}
+	if (n % 2 != 0) {
+		dft(in, n, out);
+		return;
+	}
+
+	const int half = n / 2;
+	std::vector<float> even(half), odd(half), even_fft(n), odd_fft(n);
+	for (int i = 0; i < half; i++) {
+		even[i] = in[2 * i + 0];
+		odd[i] = in[2 * i + 1];
+	}
+	fft(even.data(), half, even_fft.data());
+	fft(odd.data(), half, odd_fft.data());
+
+	const int step = MEL_N_FFT / n;
+	for (int k = 0; k < half; k++) {
+		const float re = cos_table[k * step];
+		const float im = -sin_table[k * step];
+		const float odd_re = odd_fft[2 * k + 0];
+		const float odd_im = odd_fft[2 * k + 1];
+		out[2 * k + 0] = even_fft[2 * k + 0] + re * odd_re - im * odd_im;
+		out[2 * k + 1] = even_fft[2 * k + 1] + re * odd_im + im * odd_re;
+		out[2 * (k + half) + 0] = even_fft[2 * k + 0] - re * odd_re + im * odd_im;
+		out[2 * (k + half) + 1] = even_fft[2 * k + 1] - re * odd_im - im * odd_re;
+	}
+}
+
+// librosa's Slaney-style mel scale, which whisper's filter banks were built with
+static double hz_to_mel(double hz) {
+	const double min_log_hz = 1000.0;
+	const double min_log_mel = min_log_hz / (200.0 / 3.0);
+	const double log_step = log(6.4) / 27.0;
+	return hz < min_log_hz ? hz / (200.0 / 3.0) : min_log_mel + log(hz / min_log_hz) / log_step;
+}
+
+static double mel_to_hz(double mel) {
+	const double min_log_hz = 1000.0;
+	const double min_log_mel = min_log_hz / (200.0 / 3.0);
+	const double log_step = log(6.4) / 27.0;
+	return mel < min_log_mel ? mel * (200.0 / 3.0) : min_log_hz * exp(log_step * (mel - min_log_mel));
+}
+
+// librosa.filters.mel(sr=16000, n_fft=400, n_mels=bands), area-normalized
+static void build_filters(int bands) {
+	std::vector<double> mel_hz(bands + 2);
+	const double max_mel = hz_to_mel(MEL_SAMPLE_RATE / 2.0);
+	for (int i = 0; i < bands + 2; i++) {
+		mel_hz[i] = mel_to_hz(max_mel * i / (bands + 1));
+	}
+
+	filters.assign((size_t) bands * MEL_N_BINS, 0.0f);
+	for (int m = 0; m < bands; m++) {
+		const double norm = 2.0 / (mel_hz[m + 2] - mel_hz[m]);
+		for (int k = 0; k < MEL_N_BINS; k++) {
+			const double hz = (double) k * MEL_SAMPLE_RATE / MEL_N_FFT;
+			const double lower = (hz - mel_hz[m]) / (mel_hz[m + 1] - mel_hz[m]);
+			const double upper = (mel_hz[m + 2] - hz) / (mel_hz[m + 2] - mel_hz[m + 1]);
+			filters[(size_t) m * MEL_N_BINS + k] = (float) (std::max(0.0, std::min(lower, upper)) * norm);
+		}
+	}
+	filters_n_mel = bands;
+}
+
+// log10 mel energies of one window of MEL_N_FFT samples
+static void compute_frame(const float *window, int bands, float *out) {
+	float in[MEL_N_FFT];
+	float spectrum[2 * MEL_N_FFT];
+	for (int j = 0; j < MEL_N_FFT; j++) {
+		in[j] = hann[j] * window[j];
+	}
+	fft(in, MEL_N_FFT, spectrum);
+
+	float power[MEL_N_BINS];
+	for (int k = 0; k < MEL_N_BINS; k++) {
+		power[k] = spectrum[2 * k] * spectrum[2 * k] + spectrum[2 * k + 1] * spectrum[2 * k + 1];
+	}
+	for (int m = 0; m < bands; m++) {
+		const float *filter = &filters[(size_t) m * MEL_N_BINS];
+		double sum = 0.0;
+		for (int k = 0; k < MEL_N_BINS; k++) {
+			sum += power[k] * filter[k];
+		}
+		out[m] = (float) log10(std::max(sum, 1e-10));
+	}
+}
+
+// Sample at a recording position, mirrored at the start and silent past the
+// end. Must be called with state_mutex held.
+static float sample_at(long long pos, long long n_samples) {
+	if (pos < 0) {
+		pos = -pos;
+	}
+	if (pos >= n_samples) {
+		return 0.0f;
+	}
+	if (pos < (long long) head.size()) {
+		return head[pos];
+	}
+	return pending[pos - pending_start];
+}
+
+// Copy the windows of frames [first, last) for a recording of n_samples.
+// Must be called with state_mutex held.
+static std::vector<float> gather_windows(int first, int last, long long n_samples) {
+	std::vector<float> windows((size_t) (last - first) * MEL_N_FFT);
+	for (int f = first; f < last; f++) {
+		const long long start = (long long) f * MEL_HOP - MEL_HALF_WINDOW;
+		for (int j = 0; j < MEL_N_FFT; j++) {
+			windows[(size_t) (f - first) * MEL_N_FFT + j] = sample_at(start + j, n_samples);
+		}
+	}
+	return windows;
+}
+
+static std::vector<float> compute_frames(const std::vector<float> &windows, int bands) {
+	const int count = (int) (windows.size() / MEL_N_FFT);
+	std::vector<float> result((size_t) count * bands);
+	for (int i = 0; i < count; i++) {
+		compute_frame(&windows[(size_t) i * MEL_N_FFT], bands, &result[(size_t) i * bands]);
+	}
+	return result;
+}
+
+// Frames whose whole window has been recorded. The first one also needs the
+// samples its mirrored half comes from.
+static int frames_ready(void) {
+	if (n_fed <= MEL_HALF_WINDOW) {
+		return 0;
+	}
+	return (int) ((n_fed - MEL_HALF_WINDOW) / MEL_HOP) + 1;
+}
+
+static void worker_main(void) {
+	std::unique_lock<std::mutex> lock(state_mutex);
+
+	while (!worker_stop) {
+		const int first = n_mel > 0 ? (int) (frames.size() / n_mel) : 0;
+		const int last = frames_ready();
+		if (n_mel == 0 || last <= first) {
+			state_cv.wait(lock);
+			continue;
+		}
+
+		std::vector<float> windows = gather_windows(first, last, n_fed);
+		const int bands = n_mel;
+		const int frames_generation = generation;
+		worker_busy = true;
+
+		lock.unlock();
+		double start = utils_now();
+		std::vector<float> result = compute_frames(windows, bands);
+		double duration = utils_now() - start;
+		lock.lock();
+
+		if (frames_generation == generation) {
+			frames.insert(frames.end(), result.begin(), result.end());
+			compute_seconds += duration;
+
+			// Drop the samples no later frame reads
+			const long long keep_from = (long long) last * MEL_HOP - MEL_HALF_WINDOW;
+			if (keep_from > pending_start) {
+				pending.erase(pending.begin(), pending.begin() + (keep_from - pending_start));
+				pending_start = keep_from;
+			}
+		}
+		worker_busy = false;
+		state_cv.notify_all();
+	}
+}
+
+bool mel_stream_init(void) {
+	if (running) {
+		return true;
+	}
+
+	for (int i = 0; i < MEL_N_FFT; i++) {
+		hann[i] = (float) (0.5 * (1.0 - cos(2.0 * M_PI * i / MEL_N_FFT)));
+		sin_table[i] = (float) sin(2.0 * M_PI * i / MEL_N_FFT);
+		cos_table[i] = (float) cos(2.0 * M_PI * i / MEL_N_FFT);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(state_mutex);
+		worker_stop = false;
+		n_mel = 0;
+	}
+	worker = std::thread(worker_main);
+	running = true;
+
+	log_info("🎼 Incremental mel spectrogram enabled");
+	return true;
+}
+
+void mel_stream_cleanup(void) {
+	if (!running) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(state_mutex);
+		worker_stop = true;
+	}
+	state_cv.notify_all();
+	if (worker.joinable()) {
+		worker.join();
+	}
+	running = false;
+}
+
+void mel_stream_begin(int bands) {
+	std::unique_lock<std::mutex> lock(state_mutex);
+	if (running && bands > 0 && bands != filters_n_mel) {
+		// The worker reads the filters without the lock; rebuild them only while it's idle
+		n_mel = 0;
+		while (worker_busy) {
+			state_cv.wait(lock);
+		}
+		build_filters(bands);
+	}
+	n_mel = running ? std::max(bands, 0) : 0;
+	head.clear();
+	pending.clear();
+	pending_start = 0;
+	n_fed = 0;
+	frames.clear();
+	compute_seconds = 0.0;
+	generation++;
+}
+
+bool mel_stream_is_active(void) {
+	std::lock_guard<std::mutex> lock(state_mutex);
+	return n_mel > 0;
+}
+
+void mel_stream_feed(const float *samples, int n_samples) {
+	if (!running || !samples || n_samples <= 0) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(state_mutex);
+		if (n_mel == 0) {
+			return;
+		}
+		const int head_missing = MEL_HALF_WINDOW + 1 - (int) head.size();
+		if (head_missing > 0) {
+			head.insert(head.end(), samples, samples + std::min(head_missing, n_samples));
+		}
+		pending.insert(pending.end(), samples, samples + n_samples);
+		n_fed += n_samples;
+	}
+	state_cv.notify_one();
+}
+
+MelSpectrogram *mel_stream_finish(int n_samples) {
+	double start = utils_now();
+	std::vector<float> log_mel;
+	std::vector<float> tail_windows;
+	int bands = 0;
+	int first = 0;
+	double background_seconds = 0.0;
+
+	{
+		// Let the worker finish the frames it can; only the tail is left
+		std::unique_lock<std::mutex> lock(state_mutex);
+		while (n_mel > 0 && (worker_busy || (int) (frames.size() / n_mel) < frames_ready())) {
+			state_cv.wait(lock);
+		}
+		if (n_mel == 0 || n_fed != n_samples || n_samples <= MEL_HALF_WINDOW) {
+			n_mel = 0;
+			generation++;
+			return NULL;
+		}
+
+		bands = n_mel;
+		first = (int) (frames.size() / bands);
+		// whisper computes frames while their window still overlaps the audio
+		const int last = (int) ((n_samples + MEL_HALF_WINDOW) / MEL_HOP) + 1;
+		tail_windows = gather_windows(first, std::max(first, last), n_samples);
+		log_mel.swap(frames);
+		background_seconds = compute_seconds;
+		n_mel = 0;
+		generation++;
+	}
+
+	std::vector<float> tail = compute_frames(tail_windows, bands);
+	log_mel.insert(log_mel.end(), tail.begin(), tail.end());
+
+	MelSpectrogram *mel = (MelSpectrogram *) calloc(1, sizeof(MelSpectrogram));
+	const int n_len = (n_samples + MEL_PAD_SAMPLES) / MEL_HOP;
+	const int n_frames = std::min((int) (log_mel.size() / bands), n_len);
+	if (mel) {
+		mel->data = (float *) malloc((size_t) n_len * bands * sizeof(float));
+	}
+	if (!mel || !mel->data) {
+		free(mel);
+		return NULL;
+	}
+	mel->n_len = n_len;
+	mel->n_mel = bands;
+	mel->n_samples = n_samples;
+
+	// Same clamping and scaling as whisper: at most 8 (80 dB) below the loudest value
+	float max_value = MEL_SILENT_FRAME;
+	for (int i = 0; i < n_frames * bands; i++) {
+		max_value = std::max(max_value, log_mel[i]);
+	}
+	const float floor_value = max_value - 8.0f;
+	for (int m = 0; m < bands; m++) {
+		float *row = mel->data + (size_t) m * n_len;
+		for (int f = 0; f < n_len; f++) {
+			const float value = f < n_frames ? log_mel[(size_t) f * bands + m] : MEL_SILENT_FRAME;
+			row[f] = (std::max(value, floor_value) + 4.0f) / 4.0f;
+		}
+	}
+
+	log_info("⏱️  Mel spectrogram: %d frames computed during recording (%.0f ms of work), %.1f ms after release",
+			 first, background_seconds * 1000.0, (utils_now() - start) * 1000.0);
+	return mel;
+}
+
+void mel_spectrogram_free(MelSpectrogram *mel) {
+	if (!mel) {
+		return;
+	}
+	free(mel->data);
+	free(mel);
+}
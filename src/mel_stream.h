@@ -0,0 +1,50 @@
+#ifndef MEL_STREAM_H
+#define MEL_STREAM_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Incremental log-mel spectrogram over the capture pipeline.
+// Recorded samples are fed in as they arrive and a worker thread turns them
+// into whisper's mel frames while the user is still talking, so at release
+// whisper can start at the encoder instead of at the spectrogram.
+
+// Whisper-ready spectrogram for one recording
+typedef struct MelSpectrogram {
+    float *data;   // n_mel rows of n_len frames, normalized the way whisper does it
+    int n_len;     // Frames, including whisper's 30 s of trailing silence
+    int n_mel;
+    int n_samples; // Length of the audio it was computed from
+} MelSpectrogram;
+
+// Start the worker thread
+// Returns true on success, false on failure
+bool mel_stream_init(void);
+
+// Stop the worker
+void mel_stream_cleanup(void);
+
+// Forget the previous recording and compute n_mel bands for the next one;
+// n_mel 0 leaves the next recording alone. Call before the recording starts.
+void mel_stream_begin(int n_mel);
+
+// Check if the current recording is being turned into mel frames
+bool mel_stream_is_active(void);
+
+// Feed newly recorded samples (matches audio_samples_callback)
+void mel_stream_feed(const float *samples, int n_samples);
+
+// Finish the spectrogram for the recorded samples, which must be everything
+// fed since mel_stream_begin(). Returns NULL if the recording wasn't tracked.
+MelSpectrogram *mel_stream_finish(int n_samples);
+
+void mel_spectrogram_free(MelSpectrogram *mel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEL_STREAM_H
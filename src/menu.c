@@ -17,6 +17,21 @@
 // Global variables for menu management
 int g_launch_menu_index = -1;
 int g_vad_menu_index = -1;
+int g_profile_menu_index = -1;
+
+// Menu titles for the decoding profiles, in transcription_profile_name() order
+static const char *PROFILE_LABELS[] = {"Decoding: Fast", "Decoding: Balanced", "Decoding: Accurate"};
+#define N_PROFILE_LABELS ((int) (sizeof(PROFILE_LABELS) / sizeof(PROFILE_LABELS[0])))
+
+static int current_profile_index(void) {
+    const char *current = transcription_get_profile();
+    for (int i = 0; i < N_PROFILE_LABELS && i < transcription_profile_count(); i++) {
+        if (strcmp(current, transcription_profile_name(i)) == 0) {
+            return i;
+        }
+    }
+    return 0;
+}
 
 // Menu callback functions
 static void menu_about(void) {
@@ -173,6 +188,21 @@ static void menu_toggle_vad(void) {
     }
 }
 
+// Cycle fast -> balanced -> accurate; takes effect with the next dictation
+static void menu_cycle_profile(void) {
+    int n_profiles = transcription_profile_count() < N_PROFILE_LABELS ? transcription_profile_count()
+                                                                      : N_PROFILE_LABELS;
+    int next = (current_profile_index() + 1) % n_profiles;
+
+    preferences_set_string("decode_profile", transcription_profile_name(next));
+    preferences_save();
+    log_info("Decoding profile: %s", transcription_profile_name(next));
+
+    if (g_profile_menu_index >= 0) {
+        menu_update_item(g_profile_menu_index, PROFILE_LABELS[next]);
+    }
+}
+
 static void menu_quit(void) {
     app_quit();
 }
@@ -195,6 +225,9 @@ int menu_setup_items(MenuSystem *menu) {
         preferences_get_bool("vad_enabled", true) ? "Disable VAD" : "Enable VAD";
     g_vad_menu_index = menu_add_item(menu, vad_label, menu_toggle_vad);
 
+    // Add decoding profile selector and track its index
+    g_profile_menu_index = menu_add_item(menu, PROFILE_LABELS[current_profile_index()], menu_cycle_profile);
+
     // Add launch at login toggle and track its index
     const char *launch_label =
         utils_is_launch_at_login_enabled() ? "Disable Launch at Login" : "Enable Launch at Login";
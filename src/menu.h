@@ -51,5 +51,6 @@ int menu_setup_items(MenuSystem *menu);
 // Global menu indices (for platform implementations)
 extern int g_launch_menu_index;
 extern int g_vad_menu_index;
+extern int g_profile_menu_index;
 
 #endif // MENU_H
\ No newline at end of file
@@ -71,7 +71,7 @@ static const ModelInfo* find_model_by_filename(const char* filename) {
     if (!filename) return NULL;
     
     // Check downloadable models
-    for (int i = 0; i < DOWNLOADABLE_MODELS_COUNT; i++) {
+    for (size_t i = 0; i < DOWNLOADABLE_MODELS_COUNT; i++) {
         if (strcmp(DOWNLOADABLE_MODELS[i].filename, filename) == 0) {
             return &DOWNLOADABLE_MODELS[i];
         }
@@ -8,6 +8,9 @@
 #include "app.h"
 #include <stdio.h>
 #include <string.h>
+#include "model_definitions.h"
+
+static int g_n_mels = 0; // Atomic access required
 
 // Helper function to extract filename from path
 static const char *get_filename_from_path(const char *path) {
@@ -20,11 +23,37 @@ static const char *get_filename_from_path(const char *path) {
     return filename;
 }
 
+// Two-pass dictation: keep the tiny model resident to paste a draft while the
+// main model works. The draft_model preference names another model file.
+static void load_draft_model(const char *model_path) {
+    char default_path[1024] = "";
+    const char *draft_path = preferences_get_string("draft_model");
+    const char *config_dir = utils_get_config_dir();
+    if ((!draft_path || !*draft_path) && config_dir) {
+        snprintf(default_path, sizeof(default_path), "%s/models/%s", config_dir, DOWNLOADABLE_MODELS[0].filename);
+        draft_path = default_path;
+    }
+
+    if (!draft_path || !*draft_path || !models_file_exists(draft_path)) {
+        log_error("Two-pass dictation needs the %s model; download it from Models & Languages",
+                  DOWNLOADABLE_MODELS[0].name);
+        return;
+    }
+    if (strcmp(get_filename_from_path(draft_path), get_filename_from_path(model_path)) == 0) {
+        log_info("Two-pass dictation skipped: the main model is already the draft model");
+        return;
+    }
+    if (transcription_init_draft(draft_path) != 0) {
+        log_error("Failed to load draft model %s, dictating in one pass", get_filename_from_path(draft_path));
+    }
+}
+
 // THE ONE AND ONLY MODEL LOADING FUNCTION
 int models_load(void) {
     log_info("Starting model loading at %.3f seconds", utils_now());
 
     // Cleanup existing model first
+    utils_atomic_write_int(&g_n_mels, 0);
     transcription_cleanup();
     
     overlay_show("Loading model");
@@ -92,8 +121,32 @@ int models_load(void) {
     const char *language = preferences_get_string("language");
     transcription_set_language(language ? language : "en");
 
+    // "auto" picks among the auto_languages preference, or the languages the menu offers
+    const char *auto_languages = preferences_get_string("auto_languages");
+    if (auto_languages && *auto_languages) {
+        transcription_set_auto_languages(auto_languages);
+    } else {
+        char codes[128] = "";
+        for (size_t i = 0; i < SUPPORTED_LANGUAGES_COUNT; i++) {
+            if (i > 0) strncat(codes, ",", sizeof(codes) - strlen(codes) - 1);
+            strncat(codes, SUPPORTED_LANGUAGES[i].code, sizeof(codes) - strlen(codes) - 1);
+        }
+        transcription_set_auto_languages(codes);
+    }
+
+    if (preferences_get_bool("two_pass", false)) {
+        load_draft_model(model_path);
+    }
+
+    utils_atomic_write_int(&g_n_mels, transcription_engine_n_mels(transcription_get_engine()));
+
     // Model loaded successfully
     log_info("Model loaded successfully at %.3f seconds", utils_now());
+
+    // Pay the first-inference cost in the background instead of on the first dictation
+    if (preferences_get_bool("model_warmup", true)) {
+        transcription_warmup();
+    }
     
     // Keep overlay visible for 1 second for user feedback (but not on startup)
     static bool is_startup = true;
@@ -106,6 +159,10 @@ int models_load(void) {
     return 0;
 }
 
+int models_get_n_mels(void) {
+    return utils_atomic_read_int(&g_n_mels);
+}
+
 // Get VAD model path
 const char *models_get_vad_path(void) {
     return utils_get_vad_model_path();
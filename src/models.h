@@ -6,6 +6,10 @@
 // Model loading - ONE FUNCTION FOR EVERYTHING
 int models_load(void);
 
+// Mel bands of the loaded model, 0 while none is loaded. Cached at load time,
+// so it's cheap and lock-free to ask from the key handlers.
+int models_get_n_mels(void);
+
 // Model path utilities
 const char *models_get_current_path(void);
 const char *models_get_vad_path(void);
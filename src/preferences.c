@@ -300,6 +300,26 @@ void preferences_set_bool(const char *key, bool value) {
     preferences_set_string(key, value ? "true" : "false");
 }
 
+void preferences_remove(const char *key) {
+    if (!key)
+        return;
+
+    ensure_preferences_mutex();
+    utils_mutex_lock(g_preferences_mutex);
+    if (g_preferences) {
+        PreferencesEntry **link = &g_preferences->entries;
+        while (*link && utils_stricmp((*link)->key, key) != 0) {
+            link = &(*link)->next;
+        }
+        if (*link) {
+            PreferencesEntry *entry = *link;
+            *link = entry->next;
+            free(entry);
+        }
+    }
+    utils_mutex_unlock(g_preferences_mutex);
+}
+
 bool preferences_save(void) {
     if (!g_preferences || !g_preferences->config_path)
         return false;
@@ -29,6 +29,9 @@ void preferences_set_int(const char *key, int value);
 // Set boolean value
 void preferences_set_bool(const char *key, bool value);
 
+// Remove a value so getters fall back to their defaults again
+void preferences_remove(const char *key);
+
 // Save preferences to disk
 bool preferences_save(void);
 
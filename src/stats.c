@@ -0,0 +1,20 @@
+#include "stats.h"
+#include <math.h>
+#include <stdlib.h>
+
+static int compare_doubles(const void *a, const void *b) {
+    double da = *(const double *) a;
+    double db = *(const double *) b;
+    return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+void stats_sort(double *values, int n) {
+    qsort(values, n, sizeof(double), compare_doubles);
+}
+
+double stats_percentile(const double *sorted, int n, double pct) {
+    int rank = (int) ceil(pct / 100.0 * n);
+    if (rank < 1) rank = 1;
+    if (rank > n) rank = n;
+    return sorted[rank - 1];
+}
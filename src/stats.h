@@ -0,0 +1,12 @@
+#ifndef STATS_H
+#define STATS_H
+
+// Latency statistics shared by the benchmark and the corpus runner
+
+// Sort values ascending in place
+void stats_sort(double *values, int n);
+
+// Nearest-rank percentile (0-100) of sorted values
+double stats_percentile(const double *sorted, int n, double pct);
+
+#endif // STATS_H
@@ -0,0 +1,341 @@
+#include "streaming.h"
+#include "audio.h"
+#include "logging.h"
+#include "preferences.h"
+#include "transcription.h"
+#include "utils.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLE_RATE 16000
+
+// Decode cadence while the hotkey is held
+#define DEFAULT_INTERVAL_MS 1000
+#define POLL_INTERVAL_MS 20
+
+// Don't bother decoding less than this much uncommitted audio
+#define MIN_WINDOW_SAMPLES (SAMPLE_RATE * 2)
+// Whisper's native window; without agreement by then, commit all but the last word
+#define MAX_WINDOW_SAMPLES (SAMPLE_RATE * 30)
+// Tails shorter than this are not worth a decode on release
+#define MIN_TAIL_SAMPLES (SAMPLE_RATE / 10)
+
+// Committed text passed back to whisper as context for the next window
+#define PROMPT_CHARS 200
+
+typedef struct {
+    char *text;
+    int t1_ms;
+} StreamWord;
+
+struct StreamingSession {
+    utils_thread_t *thread;
+    bool running; // Atomic access required
+    bool abort;   // Atomic access required; stops the decode in flight
+    bool active;
+    int interval_ms;
+
+    // Everything below is owned by the worker until it has been joined
+    int committed_samples; // Audio before this offset is final
+    char *committed_text;
+    size_t committed_len;
+    size_t committed_capacity;
+    int committed_words;
+
+    // Uncommitted words of the previous decode
+    StreamWord *pending;
+    int n_pending;
+
+    int n_decodes;
+};
+
+// The live session; finished sessions are detached into a heap copy
+static StreamingSession g_stream = {0};
+
+static void free_words(StreamWord *words, int count) {
+    for (int i = 0; i < count; i++) {
+        free(words[i].text);
+    }
+    free(words);
+}
+
+static void reset_state(StreamingSession *session) {
+    free(session->committed_text);
+    free_words(session->pending, session->n_pending);
+    memset(session, 0, sizeof(*session));
+}
+
+// Compare two words ignoring case, whitespace and punctuation, so a comma
+// appearing in a later decode doesn't block agreement
+static bool words_equal(const char *a, const char *b) {
+    for (;;) {
+        while (*a && ispunct((unsigned char) *a)) a++;
+        while (*b && ispunct((unsigned char) *b)) b++;
+        while (*a && isspace((unsigned char) *a)) a++;
+        while (*b && isspace((unsigned char) *b)) b++;
+        if (!*a || !*b) {
+            return !*a && !*b;
+        }
+        if (tolower((unsigned char) *a) != tolower((unsigned char) *b)) {
+            return false;
+        }
+        a++;
+        b++;
+    }
+}
+
+// Bracketed annotations like [BLANK_AUDIO] are never committed
+static bool is_annotation(const char *text) {
+    while (*text == ' ') text++;
+    size_t len = strlen(text);
+    while (len > 0 && text[len - 1] == ' ') len--;
+    return len >= 2 && (text[0] == '[' || text[0] == '(' || text[0] == '*') &&
+           (text[len - 1] == ']' || text[len - 1] == ')' || text[len - 1] == '*');
+}
+
+static void append_committed(StreamingSession *session, const char *text) {
+    size_t len = strlen(text);
+    if (session->committed_len + len + 1 > session->committed_capacity) {
+        size_t capacity = session->committed_capacity ? session->committed_capacity * 2 : 256;
+        while (capacity < session->committed_len + len + 1) capacity *= 2;
+
+        char *grown = (char *) realloc(session->committed_text, capacity);
+        if (!grown) {
+            log_error("Failed to grow streaming transcript");
+            return;
+        }
+        session->committed_text = grown;
+        session->committed_capacity = capacity;
+    }
+
+    memcpy(session->committed_text + session->committed_len, text, len + 1);
+    session->committed_len += len;
+}
+
+static const char *prompt_tail(const StreamingSession *session) {
+    if (session->committed_len == 0) {
+        return NULL;
+    }
+    if (session->committed_len <= PROMPT_CHARS) {
+        return session->committed_text;
+    }
+    return session->committed_text + session->committed_len - PROMPT_CHARS;
+}
+
+// Decode the uncommitted audio and commit the words this decode and the
+// previous one agree on
+static void stream_update(void) {
+    int n_samples = 0;
+    float *window = audio_recorder_copy_samples(g_stream.committed_samples, &n_samples);
+    if (!window) {
+        return;
+    }
+    if (n_samples < MIN_WINDOW_SAMPLES) {
+        free(window);
+        return;
+    }
+
+    double start = utils_now();
+    TranscriptionResult *result =
+        transcription_process_segments_abortable(window, n_samples, prompt_tail(&g_stream), true, &g_stream.abort);
+    free(window);
+    if (result && utils_atomic_read_bool(&g_stream.abort)) {
+        // Cut short by stop or cancel; a partial decode must not commit anything
+        transcription_result_free(result);
+        return;
+    }
+    if (!result) {
+        return;
+    }
+    g_stream.n_decodes++;
+
+    // One word per segment; drop empty words and annotations
+    StreamWord *words = (StreamWord *) calloc(result->n_segments + 1, sizeof(StreamWord));
+    int n_words = 0;
+    if (words) {
+        for (int i = 0; i < result->n_segments; i++) {
+            const char *text = result->segments[i].text;
+            if (!text || !text[0] || is_annotation(text)) {
+                continue;
+            }
+            words[n_words].text = utils_strdup(text);
+            words[n_words].t1_ms = result->segments[i].t1_ms;
+            n_words++;
+        }
+    }
+    transcription_result_free(result);
+    if (!words) {
+        return;
+    }
+
+    // Longest common prefix with the previous decode, never including the
+    // newest word since it may have been cut off mid-utterance
+    int agree = 0;
+    while (agree < n_words - 1 && agree < g_stream.n_pending && words_equal(words[agree].text, g_stream.pending[agree].text)) {
+        agree++;
+    }
+
+    // The window has grown to whisper's limit without agreement; force progress
+    if (agree == 0 && n_samples >= MAX_WINDOW_SAMPLES && n_words > 1) {
+        agree = n_words - 1;
+    }
+
+    if (agree > 0) {
+        for (int i = 0; i < agree; i++) {
+            append_committed(&g_stream, words[i].text);
+            free(words[i].text);
+        }
+        int advance = words[agree - 1].t1_ms * (SAMPLE_RATE / 1000);
+        if (advance > n_samples) {
+            advance = n_samples;
+        }
+        g_stream.committed_samples += advance;
+        g_stream.committed_words += agree;
+    }
+
+    // The rest becomes the hypothesis the next decode is compared against
+    free_words(g_stream.pending, g_stream.n_pending);
+    g_stream.n_pending = n_words - agree;
+    memmove(words, words + agree, g_stream.n_pending * sizeof(StreamWord));
+    g_stream.pending = words;
+
+    log_debug("Streaming decode of %.2f seconds took %.0f ms, committed %d words (%.2f seconds final)",
+              (float) n_samples / SAMPLE_RATE, (utils_now() - start) * 1000.0, agree,
+              (float) g_stream.committed_samples / SAMPLE_RATE);
+}
+
+static void *stream_worker(void *arg) {
+    (void) arg;
+    double next_update = utils_get_time() + g_stream.interval_ms / 1000.0;
+
+    while (utils_atomic_read_bool(&g_stream.running)) {
+        if (utils_get_time() >= next_update) {
+            stream_update();
+            next_update = utils_get_time() + g_stream.interval_ms / 1000.0;
+        } else {
+            utils_sleep_ms(POLL_INTERVAL_MS);
+        }
+    }
+
+    return NULL;
+}
+
+// Runs on the key handler thread, so abort the decode in flight instead of
+// waiting up to a full window for it to finish
+static void stop_worker(void) {
+    utils_atomic_write_bool(&g_stream.abort, true);
+    utils_atomic_write_bool(&g_stream.running, false);
+    utils_thread_join(g_stream.thread);
+    g_stream.thread = NULL;
+}
+
+bool streaming_start(void) {
+    if (g_stream.active) {
+        streaming_cancel();
+    }
+
+    g_stream.interval_ms = preferences_get_int("streaming_interval_ms", DEFAULT_INTERVAL_MS);
+    if (g_stream.interval_ms < 100) {
+        g_stream.interval_ms = 100;
+    }
+
+    utils_atomic_write_bool(&g_stream.abort, false);
+    utils_atomic_write_bool(&g_stream.running, true);
+    g_stream.thread = utils_thread_create(stream_worker, NULL);
+    if (!g_stream.thread) {
+        log_error("Failed to start streaming transcription thread");
+        reset_state(&g_stream);
+        return false;
+    }
+
+    g_stream.active = true;
+    return true;
+}
+
+StreamingSession *streaming_stop(void) {
+    if (!g_stream.active) {
+        return NULL;
+    }
+
+    stop_worker();
+
+    StreamingSession *session = (StreamingSession *) malloc(sizeof(StreamingSession));
+    if (!session) {
+        log_error("Failed to detach streaming session");
+        reset_state(&g_stream);
+        return NULL;
+    }
+    *session = g_stream;
+    session->active = false;
+    memset(&g_stream, 0, sizeof(g_stream));
+    return session;
+}
+
+char *streaming_finish(StreamingSession *session, const float *samples, int n_samples) {
+    if (!session) {
+        return NULL;
+    }
+
+    double finish_start = utils_now();
+
+    // Only the audio after the committed point still needs decoding
+    int tail_samples = n_samples - session->committed_samples;
+    char *tail_text = NULL;
+    if (samples && tail_samples >= MIN_TAIL_SAMPLES) {
+        TranscriptionResult *result = transcription_process_segments(samples + session->committed_samples,
+                                                                     tail_samples, prompt_tail(session), false);
+        if (result) {
+            size_t len = 0;
+            for (int i = 0; i < result->n_segments; i++) {
+                len += strlen(result->segments[i].text) + 1;
+            }
+            tail_text = (char *) calloc(len + 1, 1);
+            if (tail_text) {
+                for (int i = 0; i < result->n_segments; i++) {
+                    strcat(tail_text, result->segments[i].text);
+                    strcat(tail_text, " ");
+                }
+            }
+            transcription_result_free(result);
+        }
+    }
+
+    if (tail_text) {
+        append_committed(session, " ");
+        append_committed(session, tail_text);
+        free(tail_text);
+    }
+
+    char *text = transcription_clean_text(session->committed_text ? session->committed_text : "");
+
+    log_info("⏱️  Streaming finalization took %.0f ms (%d words committed during recording, %.2f seconds tail, %d "
+             "background decodes)",
+             (utils_now() - finish_start) * 1000.0, session->committed_words,
+             tail_samples > 0 ? (float) tail_samples / SAMPLE_RATE : 0.0f, session->n_decodes);
+
+    streaming_session_free(session);
+    return text;
+}
+
+void streaming_session_free(StreamingSession *session) {
+    if (!session) {
+        return;
+    }
+
+    reset_state(session);
+    free(session);
+}
+
+void streaming_cancel(void) {
+    if (!g_stream.active) {
+        return;
+    }
+
+    stop_worker();
+    reset_state(&g_stream);
+}
+
+bool streaming_is_active(void) {
+    return g_stream.active;
+}
@@ -0,0 +1,37 @@
+#ifndef STREAMING_H
+#define STREAMING_H
+
+#include <stdbool.h>
+
+// Streaming transcription - decodes the growing recording on a background
+// thread while the hotkey is held. Words are committed once two consecutive
+// decodes agree on them (local agreement), so on release only the
+// uncommitted tail of the recording has to be transcribed.
+
+typedef struct StreamingSession StreamingSession;
+
+// Start the background decoder for the recording that was just started
+// Returns true on success, false on failure
+bool streaming_start(void);
+
+// Stop the background decoder and detach what it committed, so the next
+// recording can start its own session while this one is finalized.
+// Returns NULL if no session is running.
+StreamingSession *streaming_stop(void);
+
+// Transcribe the uncommitted tail of the finished recording (the samples
+// returned by audio_recorder_take_samples) and free the session.
+// Returns the full text cleaned like transcription_process(), or NULL on error.
+// Caller must free the returned string.
+char *streaming_finish(StreamingSession *session, const float *samples, int n_samples);
+
+// Free a detached session without transcribing it
+void streaming_session_free(StreamingSession *session);
+
+// Stop the background decoder and discard everything it committed
+void streaming_cancel(void);
+
+// Check if a streaming session is running
+bool streaming_is_active(void);
+
+#endif // STREAMING_H
@@ -1,187 +1,315 @@
-#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "audio_input.h"
+#include "batch.h"
+#include "corpus.h"
 #include "logging.h"
+#include "preferences.h"
+#include "transcript_output.h"
 #include "transcription.h"
 #include "utils.h"
 
-// Simple WAV file reader
-typedef struct {
-    uint32_t sample_rate;
-    uint16_t channels;
-    uint16_t bits_per_sample;
-    uint32_t data_size;
-    float *samples;
-    int sample_count;
-} WavFile;
-
-static int read_wav_file(const char *filename, WavFile *wav) {
-    FILE *file = utils_fopen_read_binary(filename);
-    if (!file) {
-        log_error("ERROR: Could not open file: %s\n", filename);
-        return -1;
-    }
-
-    // Read RIFF header
-    char riff[4];
-    uint32_t file_size;
-    char wave[4];
-
-    if (fread(riff, 1, 4, file) != 4 ||
-        fread(&file_size, 4, 1, file) != 1 ||
-        fread(wave, 1, 4, file) != 4) {
-        log_error("ERROR: Failed to read WAV header\n");
-        fclose(file);
-        return -1;
-    }
-
-    if (strncmp(riff, "RIFF", 4) != 0 || strncmp(wave, "WAVE", 4) != 0) {
-        log_error("ERROR: Not a valid WAV file\n");
-        fclose(file);
-        return -1;
-    }
-
-    // Read chunks
-    uint16_t format_tag = 0;
-    wav->channels = 0;
-    wav->sample_rate = 0;
-    wav->bits_per_sample = 0;
-    wav->data_size = 0;
-
-    while (!feof(file)) {
-        char chunk_id[4];
-        uint32_t chunk_size;
-
-        if (fread(chunk_id, 1, 4, file) != 4)
-            break;
-        if (fread(&chunk_size, 4, 1, file) != 1)
-            break;
-
-        if (strncmp(chunk_id, "fmt ", 4) == 0) {
-            if (fread(&format_tag, 2, 1, file) != 1 ||
-                fread(&wav->channels, 2, 1, file) != 1 ||
-                fread(&wav->sample_rate, 4, 1, file) != 1) {
-                log_error("ERROR: Failed to read fmt chunk\n");
-                fclose(file);
-                return -1;
-            }
-            fseek(file, 6, SEEK_CUR); // skip byte_rate and block_align
-            if (fread(&wav->bits_per_sample, 2, 1, file) != 1) {
-                log_error("ERROR: Failed to read bits_per_sample\n");
-                fclose(file);
-                return -1;
-            }
-            fseek(file, chunk_size - 16, SEEK_CUR); // skip rest of fmt chunk
-        } else if (strncmp(chunk_id, "data", 4) == 0) {
-            wav->data_size = chunk_size;
-
-            // Allocate buffer for samples
-            int bytes_per_sample = wav->bits_per_sample / 8;
-            wav->sample_count = wav->data_size / bytes_per_sample / wav->channels;
-            wav->samples = (float *) malloc(wav->sample_count * sizeof(float));
-
-            if (!wav->samples) {
-                log_error("ERROR: Failed to allocate memory for samples\n");
-                fclose(file);
-                return -1;
-            }
+// Re-run the inference thread tuner for a model and store the result
+static int tune_threads(const char *model_path) {
+    printf("Tuning inference threads for: %s\n", model_path);
+    if (transcription_init(model_path) != 0) {
+        printf("Error: Failed to initialize transcription\n");
+        return 1;
+    }
 
-            // Read and convert samples to float
-            if (format_tag == 3 && wav->bits_per_sample == 32) {
-                // 32-bit float
-                for (int i = 0; i < wav->sample_count; i++) {
-                    float sample_sum = 0.0f;
-                    for (int ch = 0; ch < wav->channels; ch++) {
-                        float sample;
-                        if (fread(&sample, 4, 1, file) != 1) {
-                            log_error("ERROR: Failed to read sample data\n");
-                            free(wav->samples);
-                            fclose(file);
-                            return -1;
-                        }
-                        sample_sum += sample;
-                    }
-                    wav->samples[i] = sample_sum / wav->channels;
-                }
-            } else if (format_tag == 1 && wav->bits_per_sample == 16) {
-                // 16-bit PCM
-                for (int i = 0; i < wav->sample_count; i++) {
-                    float sample_sum = 0.0f;
-                    for (int ch = 0; ch < wav->channels; ch++) {
-                        int16_t sample;
-                        if (fread(&sample, 2, 1, file) != 1) {
-                            log_error("ERROR: Failed to read sample data\n");
-                            free(wav->samples);
-                            fclose(file);
-                            return -1;
-                        }
-                        sample_sum += (float) sample / 32768.0f;
-                    }
-                    wav->samples[i] = sample_sum / wav->channels;
-                }
-            } else {
-                log_error("ERROR: Unsupported WAV format (format=%d, bits=%d)\n", format_tag, wav->bits_per_sample);
-                free(wav->samples);
-                fclose(file);
-                return -1;
-            }
+    int n_threads = transcription_tune_threads();
+    transcription_cleanup();
+    if (n_threads < 0) {
+        printf("Error: Thread tuning failed\n");
+        return 1;
+    }
+
+    printf("Best thread count: %d (saved to %s)\n", n_threads, preferences_get_path());
+    return 0;
+}
+
+#define LONG_FORM_SAMPLES (16000 * 60)
+#define LONG_FORM_STATES 4
+
+#define MAX_CORPUS_MODELS 8
+#define MAX_CORPUS_PROFILES 8
+
+// Run a regression corpus; argv[0] is the manifest, the rest are options
+static int run_corpus(int argc, char *argv[]) {
+    const char *models[MAX_CORPUS_MODELS];
+    const char *profiles[MAX_CORPUS_PROFILES];
+    CorpusOptions options = {0};
+    options.manifest_path = argv[0];
+    options.models = models;
+    options.profiles = profiles;
+    options.max_wer_increase = 0.01;
+    options.max_cer_increase = 0.01;
+    options.max_rtf_increase = 0.10;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char *value = argv[i + 1];
+        if (strcmp(argv[i], "--model") == 0 && options.n_models < MAX_CORPUS_MODELS) {
+            models[options.n_models++] = value;
+        } else if (strcmp(argv[i], "--profile") == 0 && options.n_profiles < MAX_CORPUS_PROFILES) {
+            profiles[options.n_profiles++] = value;
+        } else if (strcmp(argv[i], "--report") == 0) {
+            options.report_path = value;
+        } else if (strcmp(argv[i], "--baseline") == 0) {
+            options.baseline_path = value;
+        } else if (strcmp(argv[i], "--max-wer-increase") == 0) {
+            options.max_wer_increase = atof(value);
+        } else if (strcmp(argv[i], "--max-cer-increase") == 0) {
+            options.max_cer_increase = atof(value);
+        } else if (strcmp(argv[i], "--max-rtf-increase") == 0) {
+            options.max_rtf_increase = atof(value);
+        } else {
+            printf("Error: Unknown corpus option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (argc % 2 == 0) {
+        printf("Error: Missing value for %s\n", argv[argc - 1]);
+        return 1;
+    }
+
+    if (options.n_models == 0) {
+        models[0] = utils_get_model_path();
+        if (!models[0]) {
+            printf("Error: Could not find Whisper model file\n");
+            return 1;
+        }
+        options.n_models = 1;
+    }
 
-            break; // Done reading
+    return corpus_run(&options);
+}
+
+// Transcribe a directory or list of files; argv[0] is the input, the rest are options
+static int run_batch(int argc, char *argv[]) {
+    BatchOptions options = {0};
+    options.input = argv[0];
+    options.output_path = "transcripts.jsonl";
+    options.language = "auto";
+    options.jobs = 1;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char *value = argv[i + 1];
+        if (strcmp(argv[i], "--model") == 0) {
+            options.model_path = value;
+        } else if (strcmp(argv[i], "--output") == 0) {
+            options.output_path = value;
+        } else if (strcmp(argv[i], "--language") == 0) {
+            options.language = value;
+        } else if (strcmp(argv[i], "--jobs") == 0) {
+            options.jobs = atoi(value);
+        } else if (strcmp(argv[i], "--threads-per-job") == 0) {
+            options.threads_per_job = atoi(value);
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            if (!transcription_set_profile(value)) {
+                printf("Error: Unknown decoding profile: %s\n", value);
+                return 1;
+            }
         } else {
-            // Skip unknown chunk
-            fseek(file, chunk_size, SEEK_CUR);
+            printf("Error: Unknown batch option: %s\n", argv[i]);
+            return 1;
         }
     }
+    if (argc % 2 == 0) {
+        printf("Error: Missing value for %s\n", argv[argc - 1]);
+        return 1;
+    }
 
-    fclose(file);
+    if (!options.model_path) {
+        options.model_path = utils_get_model_path();
+        if (!options.model_path) {
+            printf("Error: Could not find Whisper model file\n");
+            return 1;
+        }
+    }
+
+    return batch_run(&options);
+}
 
-    if (wav->sample_count == 0) {
-        log_error("ERROR: No audio data found in file\n");
-        return -1;
+// Use more decoder states for long recordings, which are split at pauses and
+// decoded in parallel pieces
+static void use_long_form_states(int n_samples) {
+    if (n_samples >= LONG_FORM_SAMPLES && preferences_get_int("transcription_states", 1) < LONG_FORM_STATES) {
+        preferences_set_int("transcription_states", LONG_FORM_STATES); // Not saved
     }
+}
 
-    log_info("📊 WAV file info: %d Hz, %d channels, %d bits, %d samples\n", wav->sample_rate, wav->channels,
-             wav->bits_per_sample, wav->sample_count);
+// Transcribe one file to JSON, SRT or VTT on stdout or in output_path
+static int write_transcript(const char *audio_file, const char *model_path, TranscriptFormat format,
+                            const char *output_path) {
+    int n_samples = 0;
+    float *samples = audio_input_read_file(audio_file, &n_samples);
+    if (!samples) {
+        printf("Error: Failed to read audio file\n");
+        return 1;
+    }
+    use_long_form_states(n_samples);
 
-    return 0;
+    if (transcription_init(model_path) != 0) {
+        printf("Error: Failed to initialize transcription\n");
+        free(samples);
+        return 1;
+    }
+    transcription_set_language("auto");
+
+    TranscriptionResult *result = transcription_process_detailed(samples, n_samples);
+    free(samples);
+    if (!result) {
+        printf("Error: Transcription failed\n");
+        transcription_cleanup();
+        return 1;
+    }
+
+    FILE *out = output_path ? utils_fopen_write(output_path) : stdout;
+    if (out) {
+        transcript_write(out, result, format, (double) n_samples / 16000.0);
+        if (out != stdout) {
+            fclose(out);
+        }
+    } else {
+        printf("Error: Could not write %s\n", output_path);
+    }
+
+    transcription_result_free(result);
+    transcription_cleanup();
+    return out ? 0 : 1;
 }
 
 int main(int argc, char *argv[]) {
     if (argc < 2) {
-        printf("Usage: %s <audio_file.wav> [model_path]\n", argv[0]);
+        printf("Usage: %s <audio_file> [model_path] [--format json|srt|vtt] [--output path]\n", argv[0]);
+        printf("                 [--profile fast|balanced|accurate]\n");
+        printf("       %s --tune-threads [model_path]\n", argv[0]);
+        printf("       %s --corpus <manifest.tsv> [--model path]... [--profile name:key=value,...]...\n", argv[0]);
+        printf("                 [--report out.json] [--baseline baseline.json]\n");
+        printf("                 [--max-wer-increase 0.01] [--max-cer-increase 0.01] [--max-rtf-increase 0.10]\n");
+        printf("       %s --batch <directory|list.txt> [--model path] [--output transcripts.jsonl]\n", argv[0]);
+        printf("                 [--jobs N] [--threads-per-job N] [--language auto] [--profile name]\n");
         printf("Example: %s ./out.wav\n", argv[0]);
         printf("Example: %s ./out.wav /path/to/ggml-model.bin\n", argv[0]);
+        printf("Example: %s ./talk.mp3 --output talk.srt\n", argv[0]);
+        printf("Example: %s --corpus clips.tsv --profile fast:decode_profile=fast\n", argv[0]);
         return 1;
     }
 
+    // User settings (VAD, tuned thread counts) apply here as in the app
+    preferences_init();
+
+    if (strcmp(argv[1], "--tune-threads") == 0) {
+        const char *model_path = argc >= 3 ? argv[2] : utils_get_model_path();
+        if (!model_path) {
+            printf("Error: Could not find Whisper model file\n");
+            return 1;
+        }
+        int result = tune_threads(model_path);
+        preferences_cleanup();
+        return result;
+    }
+
+    if (strcmp(argv[1], "--batch") == 0) {
+        if (argc < 3) {
+            printf("Error: --batch needs a directory or file list\n");
+            preferences_cleanup();
+            return 1;
+        }
+        int result = run_batch(argc - 2, argv + 2);
+        preferences_cleanup();
+        return result;
+    }
+
+    // Exits 2 when a result regressed past the baseline thresholds
+    if (strcmp(argv[1], "--corpus") == 0) {
+        if (argc < 3) {
+            printf("Error: --corpus needs a manifest file\n");
+            preferences_cleanup();
+            return 1;
+        }
+        int result = run_corpus(argc - 2, argv + 2);
+        preferences_cleanup();
+        return result;
+    }
+
     const char *audio_file = argv[1];
     const char *model_path = NULL;
+    const char *format_name = NULL;
+    const char *output_path = NULL;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            format_name = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            // Overrides the decode_profile preference for this run
+            if (!transcription_set_profile(argv[++i])) {
+                printf("Error: Unknown decoding profile: %s (use fast, balanced or accurate)\n", argv[i]);
+                preferences_cleanup();
+                return 1;
+            }
+        } else if (!model_path && argv[i][0] != '-') {
+            model_path = argv[i];
+        } else {
+            printf("Error: Unknown option: %s\n", argv[i]);
+            preferences_cleanup();
+            return 1;
+        }
+    }
 
-    // Check if model path was provided as second argument
-    if (argc >= 3) {
-        model_path = argv[2];
-    } else {
+    if (!model_path) {
         // Get default model path
         model_path = utils_get_model_path();
         if (!model_path) {
             printf("Error: Could not find Whisper model file\n");
+            preferences_cleanup();
             return 1;
         }
     }
 
+    // Structured output; the format defaults to the output file's extension
+    if (format_name || output_path) {
+        const char *extension = output_path ? strrchr(output_path, '.') : NULL;
+        if (!format_name) {
+            format_name = extension ? extension + 1 : "";
+        }
+        TranscriptFormat format;
+        if (!transcript_format_parse(format_name, &format)) {
+            printf("Error: Unknown output format: %s (use json, srt or vtt)\n", format_name);
+            preferences_cleanup();
+            return 1;
+        }
+        int result = write_transcript(audio_file, model_path, format, output_path);
+        preferences_cleanup();
+        return result;
+    }
+
     printf("=== Whisper Transcription Performance Test ===\n");
     printf("Audio file: %s\n", audio_file);
+    printf("Decoding profile: %s\n", transcription_get_profile());
 
     double start_time = utils_now();
 
+    // Read audio file (WAV, FLAC or MP3; converted to 16 kHz mono)
+    int n_samples = 0;
+    float *samples = audio_input_read_file(audio_file, &n_samples);
+    if (!samples) {
+        printf("Error: Failed to read audio file\n");
+        return 1;
+    }
+
+    use_long_form_states(n_samples);
+
     printf("Using model: %s\n", model_path);
     printf("Loading model...\n");
     double model_load_start = utils_now();
 
     if (transcription_init(model_path) != 0) {
         printf("Error: Failed to initialize transcription\n");
+        free(samples);
         return 1;
     }
 
@@ -190,23 +318,14 @@ int main(int argc, char *argv[]) {
     double model_load_time = utils_now() - model_load_start;
     printf("Model loaded in %.2f ms\n", model_load_time * 1000.0);
 
-    // Read WAV file
-    WavFile wav = {0};
-    if (read_wav_file(audio_file, &wav) != 0) {
-        printf("Error: Failed to read WAV file\n");
-        transcription_cleanup();
-        return 1;
-    }
-
     // Calculate audio duration
-    double audio_duration_sec = (double) wav.sample_count / wav.sample_rate;
-    printf("Audio duration: %.2f seconds (%d samples at %d Hz)\n", audio_duration_sec, wav.sample_count,
-           wav.sample_rate);
+    double audio_duration_sec = (double) n_samples / 16000.0;
+    printf("Audio duration: %.2f seconds (%d samples at 16000 Hz)\n", audio_duration_sec, n_samples);
 
     // Transcribe audio
     printf("Starting transcription...\n");
     double transcribe_start = utils_now();
-    char *result = transcription_process(wav.samples, wav.sample_count, wav.sample_rate);
+    char *result = transcription_process(samples, n_samples, 16000);
     double transcribe_time = utils_now() - transcribe_start;
 
     if (result) {
@@ -235,8 +354,9 @@ int main(int argc, char *argv[]) {
     printf("Total time: %.2f ms\n", total_time * 1000.0);
 
     // Cleanup
-    free(wav.samples);
+    free(samples);
     transcription_cleanup();
+    preferences_cleanup();
 
     return 0;
 }
\ No newline at end of file
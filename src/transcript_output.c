@@ -0,0 +1,115 @@
+#include "transcript_output.h"
+#include "utils.h"
+#include <ctype.h>
+#include <string.h>
+
+bool transcript_format_parse(const char *name, TranscriptFormat *format) {
+    if (utils_stricmp(name, "json") == 0) {
+        *format = TRANSCRIPT_FORMAT_JSON;
+    } else if (utils_stricmp(name, "srt") == 0) {
+        *format = TRANSCRIPT_FORMAT_SRT;
+    } else if (utils_stricmp(name, "vtt") == 0) {
+        *format = TRANSCRIPT_FORMAT_VTT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void transcript_json_string(FILE *out, const char *str) {
+    fputc('"', out);
+    for (const char *p = str ? str : ""; *p; p++) {
+        unsigned char c = (unsigned char) *p;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// Segment text without whisper's leading space or trailing whitespace
+static void write_trimmed(FILE *out, const char *text) {
+    if (!text) {
+        return;
+    }
+    while (isspace((unsigned char) *text)) {
+        text++;
+    }
+    size_t len = strlen(text);
+    while (len > 0 && isspace((unsigned char) text[len - 1])) {
+        len--;
+    }
+    fwrite(text, 1, len, out);
+}
+
+static bool is_blank(const char *text) {
+    for (const char *p = text ? text : ""; *p; p++) {
+        if (!isspace((unsigned char) *p)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// hh:mm:ss plus milliseconds after separator (',' for SRT, '.' for VTT)
+static void write_timestamp(FILE *out, int ms, char separator) {
+    if (ms < 0) {
+        ms = 0;
+    }
+    fprintf(out, "%02d:%02d:%02d%c%03d", ms / 3600000, ms / 60000 % 60, ms / 1000 % 60, separator, ms % 1000);
+}
+
+static void write_json(FILE *out, const TranscriptionResult *result, double audio_seconds) {
+    fprintf(out, "{\n  \"audio_s\": %.3f,\n  \"segments\": [", audio_seconds);
+    for (int i = 0; i < result->n_segments; i++) {
+        const TranscriptionSegment *segment = &result->segments[i];
+        fprintf(out, "%s\n    {\"t0_ms\": %d, \"t1_ms\": %d, \"no_speech_prob\": %.4f, \"text\": ", i > 0 ? "," : "",
+                segment->t0_ms, segment->t1_ms, segment->no_speech_prob);
+        transcript_json_string(out, segment->text);
+        fprintf(out, ",\n     \"tokens\": [");
+        for (int j = 0; j < segment->n_tokens; j++) {
+            const TranscriptionToken *token = &segment->tokens[j];
+            fprintf(out, "%s{\"text\": ", j > 0 ? ", " : "");
+            transcript_json_string(out, token->text);
+            fprintf(out, ", \"t0_ms\": %d, \"t1_ms\": %d, \"p\": %.4f}", token->t0_ms, token->t1_ms, token->p);
+        }
+        fprintf(out, "]}");
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
+
+static void write_subtitles(FILE *out, const TranscriptionResult *result, TranscriptFormat format) {
+    char separator = format == TRANSCRIPT_FORMAT_SRT ? ',' : '.';
+    if (format == TRANSCRIPT_FORMAT_VTT) {
+        fprintf(out, "WEBVTT\n\n");
+    }
+
+    int cue = 0;
+    for (int i = 0; i < result->n_segments; i++) {
+        const TranscriptionSegment *segment = &result->segments[i];
+        if (is_blank(segment->text)) {
+            continue;
+        }
+        if (format == TRANSCRIPT_FORMAT_SRT) {
+            fprintf(out, "%d\n", ++cue);
+        }
+        write_timestamp(out, segment->t0_ms, separator);
+        fprintf(out, " --> ");
+        write_timestamp(out, segment->t1_ms, separator);
+        fputc('\n', out);
+        write_trimmed(out, segment->text);
+        fprintf(out, "\n\n");
+    }
+}
+
+void transcript_write(FILE *out, const TranscriptionResult *result, TranscriptFormat format, double audio_seconds) {
+    if (format == TRANSCRIPT_FORMAT_JSON) {
+        write_json(out, result, audio_seconds);
+    } else {
+        write_subtitles(out, result, format);
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef TRANSCRIPT_OUTPUT_H
+#define TRANSCRIPT_OUTPUT_H
+
+#include "transcription.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+// Structured transcript writers for the transcribe tool. JSON carries every
+// segment with its timing, no-speech probability and tokens; SRT and VTT are
+// subtitle files with one cue per segment.
+
+typedef enum {
+    TRANSCRIPT_FORMAT_JSON,
+    TRANSCRIPT_FORMAT_SRT,
+    TRANSCRIPT_FORMAT_VTT
+} TranscriptFormat;
+
+// "json", "srt" or "vtt"; returns false for anything else
+bool transcript_format_parse(const char *name, TranscriptFormat *format);
+
+// Write str as a quoted JSON string (NULL as "")
+void transcript_json_string(FILE *out, const char *str);
+
+void transcript_write(FILE *out, const TranscriptionResult *result, TranscriptFormat format, double audio_seconds);
+
+#endif // TRANSCRIPT_OUTPUT_H
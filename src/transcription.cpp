@@ -4,20 +4,134 @@ extern "C" {
 #include "utils.h"
 #include "preferences.h"
 #include "models.h"
+#include "vad.h"
+#include "audio_input.h"
+#include "mel_stream.h"
 }
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
 #include <vector>
-#include <fstream>
 #include <thread>
 #include "whisper.h"
 #include "../whisper.cpp/ggml/include/ggml.h"
-
-static struct whisper_context *ctx = NULL;
-static utils_mutex_t *ctx_mutex = NULL;  // Thread safety for transcription context
+#include "../whisper.cpp/ggml/include/ggml-cpu.h"
+
+#define SAMPLE_RATE 16000
+
+// Encoder positions per second of audio (whisper's 30 s window is 1500)
+#define AUDIO_CTX_PER_SECOND 50
+// Slack after the end of the clip so the last word isn't cut off (~1.3 s)
+#define AUDIO_CTX_MARGIN 64
+// A reduced-context result is re-run at full context if its tokens are less
+// confident than this on average, if it stops this long before the end of the
+// clip, or if it produces implausibly much text (a repetition loop)
+#define MIN_AVG_TOKEN_P 0.5f
+#define MAX_TAIL_GAP_MS 1500
+#define MAX_CHARS_PER_SECOND 25.0f
+
+// Repetition loops: decoding stops once the newest n text tokens (n up to
+// LOOP_MAX_NGRAM) have come LOOP_MIN_REPEATS times back to back covering at
+// least LOOP_MIN_SPAN tokens, or once a window holds more text tokens than
+// MAX_TOKENS_PER_SECOND of its audio explains
+#define LOOP_MAX_NGRAM 16
+#define LOOP_MIN_REPEATS 3
+#define LOOP_MIN_SPAN 12
+#define MAX_TOKENS_PER_SECOND 10
+#define MAX_TOKENS_SLACK 30
+
+// Without VAD, a clip only goes to whisper if it has at least GATE_MIN_FRAMES
+// voiced frames: loud enough, and with the low zero-crossing rate of voicing
+// rather than that of breath or hiss
+#define GATE_FRAME_SAMPLES (SAMPLE_RATE / 50)
+#define GATE_MIN_RMS 0.003f// About -50 dBFS
+#define GATE_MAX_ZCR 0.25f
+#define GATE_MIN_FRAMES 10
+
+// With language "auto", below this share of the allowed languages' probability
+// the runner-up language is decoded too and the more confident text kept
+#define LANG_MIN_CONFIDENCE 0.8f
+
+// Recordings at least this long are split at pauses and the pieces decoded
+// concurrently on the state pool
+#define LONG_FORM_MIN_SAMPLES (SAMPLE_RATE * 60)
+// Decoder states of the default engine unless transcription_states says
+// otherwise: two, so long dictations get their pieces decoded in parallel.
+// Each state adds its KV caches and compute buffers (logged at load).
+#define DEFAULT_STATES 2
+// Pieces are kept to one whisper window; without VAD, cut at the quietest
+// frame between the two lengths
+#define CHUNK_MAX_SAMPLES (SAMPLE_RATE * 30)
+#define CHUNK_MIN_SAMPLES (SAMPLE_RATE * 20)
+#define QUIET_FRAME_SAMPLES (SAMPLE_RATE / 10)
+
+// Decoding settings that trade accuracy for latency, selected by name. Every
+// field can be overridden in preferences as profile_<name>_<field>, e.g.
+// profile_accurate_beam_size = 8.
+typedef struct {
+	const char *name;
+	bool beam_search;     // Beam search instead of greedy sampling ("sampling" = greedy | beam_search)
+	int beam_size;        // Beams, or candidates per fallback temperature when greedy
+	float temperature_inc;// Fallback step for decodes that fail the thresholds below; 0 disables
+	float entropy_thold;
+	float logprob_thold;
+	bool no_timestamps;   // Only when the caller reads nothing but the text
+	bool single_segment;
+	int max_tokens;       // Per segment, 0 for no limit
+	int audio_ctx;        // -1 sized to the clip, 0 whisper's full window, else fixed
+} DecodeProfile;
+
+static const DecodeProfile DECODE_PROFILES[] = {
+	{"fast", false, 1, 0.0f, 2.4f, -1.0f, true, true, 0, -1},
+	{"balanced", false, 5, 0.2f, 2.4f, -1.0f, false, false, 0, -1},// whisper's defaults
+	{"accurate", true, 5, 0.2f, 2.4f, -1.0f, false, false, 0, 0},
+};
+#define N_DECODE_PROFILES ((int) (sizeof(DECODE_PROFILES) / sizeof(DECODE_PROFILES[0])))
+#define DEFAULT_DECODE_PROFILE 1
+
+// Reduced encoder windows; a clip is rounded up to the smallest that fits.
+// Keeping to a few sizes limits the distinct compute graphs the backend builds.
+static const int AUDIO_CTX_BUCKETS[] = {256, 384, 512, 768, 1024};
+
+// One loaded model serving a pool of decoder states. The weights live in the
+// context and are shared; each state holds its own KV caches and compute
+// buffers, so transcriptions on different states can run concurrently.
+struct TranscriptionEngine {
+	struct whisper_context *ctx;
+	std::vector<struct whisper_state *> states;
+	std::vector<bool> in_use;
+	std::atomic<int> n_threads;// Thread budget, split across the decodes running at once
+	char model_name[256];// File name of the model, for keying tuned settings
+
+	std::mutex pool_mutex;
+	std::condition_variable pool_cv;
+	int pending;// Transcriptions that hold or wait for a state
+	std::atomic<int> waiters;// Transcriptions blocked on a busy pool
+
+	// Background warm-up; aborts as soon as a real transcription needs its state
+	std::thread warmup_thread;
+	std::atomic<bool> stopping;
+};
+
+static TranscriptionEngine *g_engine = NULL;// Engine behind transcription_init()/transcription_process()
+static TranscriptionEngine *g_draft_engine = NULL;// Small model for two-pass dictation, guarded by ctx_mutex
+static struct whisper_vad_context *vad_ctx = NULL;// Loaded once, guarded by vad_mutex
+static std::mutex vad_mutex;// Held for every VAD pass; taken after ctx_mutex, never before
+static utils_mutex_t *ctx_mutex = NULL;  // Guards g_engine, g_draft_engine and g_language
 static char g_language[16] = "en";// Default to English
+static std::vector<int> g_auto_languages;// whisper language ids "auto" may pick, empty for any; guarded by ctx_mutex
+static std::atomic<int> g_profile(-1);// Index into DECODE_PROFILES, or -1 for the decode_profile preference
+static std::atomic<unsigned> g_cancel_generation(0);// Bumped by transcription_cancel()
+static std::atomic<int> g_loops_stopped(0);
+static std::atomic<int> g_clips_skipped(0);
+static std::atomic<long long> g_skipped_audio_ms(0);
 
 // Initialize mutex on first use
 static void ensure_mutex_initialized(void) {
@@ -34,47 +148,250 @@ static void null_log_callback(enum ggml_log_level level, const char *text, void
 	// Do nothing - suppress all whisper/ggml logs
 }
 
+// Sums the buffer sizes whisper_init_state logs, e.g.
+// "whisper_init_state: kv self size  =    6.29 MB"
+static void state_memory_log_callback(enum ggml_log_level level, const char *text, void *user_data) {
+	(void) level;
+	double *total_mb = (double *) user_data;
+	const char *value = strstr(text, "whisper_init_state:") ? strchr(text, '=') : NULL;
+	double mb = 0.0;
+	if (value && strstr(value, "MB") && sscanf(value + 1, "%lf", &mb) == 1) {
+		*total_mb += mb;
+	}
+}
+
 void transcription_set_language(const char *language) {
 	ensure_mutex_initialized();
 	utils_mutex_lock(ctx_mutex);
-	
+
 	if (language && strlen(language) > 0) {
 		strncpy(g_language, language, sizeof(g_language) - 1);
 		g_language[sizeof(g_language) - 1] = '\0';
 		log_info("🌐 Transcription language set to: %s\n", g_language);
 	}
-	
+
 	utils_mutex_unlock(ctx_mutex);
 }
 
-int transcription_init(const char *model_path) {
-	ensure_mutex_initialized();
-	
-	log_debug("transcription_init() ENTRY - thread=%p, model_path=%s", 
-		   utils_thread_id(), model_path ? model_path : "NULL");
-		   
-	if (!model_path) {
-		log_error("ERROR: No model path provided");
-		return -1;
+static int find_profile(const char *name) {
+	for (int i = 0; name && i < N_DECODE_PROFILES; i++) {
+		if (utils_stricmp(name, DECODE_PROFILES[i].name) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// The profile transcriptions use right now
+static int active_profile(void) {
+	int index = g_profile.load();
+	if (index < 0) {
+		index = find_profile(preferences_get_string("decode_profile"));
 	}
+	return index < 0 ? DEFAULT_DECODE_PROFILE : index;
+}
 
+static float profile_float(const char *key, float value) {
+	const char *text = preferences_get_string(key);
+	char *end = NULL;
+	double parsed = text ? strtod(text, &end) : 0.0;
+	return text && end != text && *end == '\0' ? (float) parsed : value;
+}
+
+// A built-in profile with the user's overrides applied
+static DecodeProfile load_profile(int index) {
+	DecodeProfile profile = DECODE_PROFILES[index];
+	char prefix[32];
+	char key[64];
+	snprintf(prefix, sizeof(prefix), "profile_%s_", profile.name);
+
+	snprintf(key, sizeof(key), "%ssampling", prefix);
+	const char *sampling = preferences_get_string(key);
+	if (sampling && utils_stricmp(sampling, "greedy") == 0) {
+		profile.beam_search = false;
+	} else if (sampling && utils_stricmp(sampling, "beam_search") == 0) {
+		profile.beam_search = true;
+	}
+	snprintf(key, sizeof(key), "%sbeam_size", prefix);
+	profile.beam_size = std::max(1, preferences_get_int(key, profile.beam_size));
+	snprintf(key, sizeof(key), "%stemperature_inc", prefix);
+	profile.temperature_inc = profile_float(key, profile.temperature_inc);
+	snprintf(key, sizeof(key), "%sentropy_thold", prefix);
+	profile.entropy_thold = profile_float(key, profile.entropy_thold);
+	snprintf(key, sizeof(key), "%slogprob_thold", prefix);
+	profile.logprob_thold = profile_float(key, profile.logprob_thold);
+	snprintf(key, sizeof(key), "%sno_timestamps", prefix);
+	profile.no_timestamps = preferences_get_bool(key, profile.no_timestamps);
+	snprintf(key, sizeof(key), "%ssingle_segment", prefix);
+	profile.single_segment = preferences_get_bool(key, profile.single_segment);
+	snprintf(key, sizeof(key), "%smax_tokens", prefix);
+	profile.max_tokens = std::max(0, preferences_get_int(key, profile.max_tokens));
+	snprintf(key, sizeof(key), "%saudio_ctx", prefix);
+	profile.audio_ctx = preferences_get_int(key, profile.audio_ctx);
+	return profile;
+}
+
+int transcription_profile_count(void) {
+	return N_DECODE_PROFILES;
+}
+
+const char *transcription_profile_name(int index) {
+	return index >= 0 && index < N_DECODE_PROFILES ? DECODE_PROFILES[index].name : NULL;
+}
+
+bool transcription_set_profile(const char *name) {
+	if (!name) {
+		g_profile = -1;
+		return true;
+	}
+	int index = find_profile(name);
+	if (index < 0) {
+		log_error("Unknown decoding profile: %s", name);
+		return false;
+	}
+	g_profile = index;
+	log_info("🎚️  Decoding profile set to: %s", DECODE_PROFILES[index].name);
+	return true;
+}
+
+const char *transcription_get_profile(void) {
+	return DECODE_PROFILES[active_profile()].name;
+}
+
+void transcription_set_auto_languages(const char *codes) {
+	ensure_mutex_initialized();
 	utils_mutex_lock(ctx_mutex);
-	log_debug("Acquired transcription mutex - thread=%p", utils_thread_id());
 
-	// Check if already initialized
-	if (ctx != NULL) {
-		log_debug("Already initialized, returning 0 - thread=%p", utils_thread_id());
-		log_info("Transcription already initialized");
-		utils_mutex_unlock(ctx_mutex);
-		return 0;
+	g_auto_languages.clear();
+	std::string list = codes ? codes : "";
+	size_t start = 0;
+	while (start < list.size()) {
+		size_t end = list.find(',', start);
+		if (end == std::string::npos) {
+			end = list.size();
+		}
+		std::string code = list.substr(start, end - start);
+		code.erase(0, code.find_first_not_of(" \t"));
+		code.erase(code.find_last_not_of(" \t") + 1);
+		int id = code.empty() ? -1 : whisper_lang_id(code.c_str());
+		if (id >= 0) {
+			g_auto_languages.push_back(id);
+		} else if (!code.empty()) {
+			log_error("Unknown language code in auto-detection list: %s", code.c_str());
+		}
+		start = end + 1;
+	}
+	log_info("🌐 Auto-detection limited to %d languages", (int) g_auto_languages.size());
+
+	utils_mutex_unlock(ctx_mutex);
+}
+
+// Load the Silero VAD model on first use and keep it for the process lifetime.
+// Must be called with vad_mutex held.
+static bool ensure_vad_context(void) {
+	if (vad_ctx) {
+		return true;
+	}
+
+	const char *vad_model_path = models_get_vad_path();
+	if (!vad_model_path) {
+		return false;
+	}
+
+	double start = utils_now();
+	struct whisper_vad_context_params vparams = whisper_vad_default_context_params();
+	vad_ctx = whisper_vad_init_from_file_with_params(vad_model_path, vparams);
+	if (!vad_ctx) {
+		log_error("ERROR: Failed to load VAD model: %s", vad_model_path);
+		return false;
+	}
+
+	log_info("✅ VAD model loaded: %s (took %.0f ms)", vad_model_path, (utils_now() - start) * 1000.0);
+	return true;
+}
+
+// Preference key for the tuned thread count of this model on this CPU
+static void tuning_key(const TranscriptionEngine *engine, char *key, size_t size) {
+	utils_cpu_info_t cpu;
+	utils_get_cpu_info(&cpu);
+
+	char id[512];
+	snprintf(id, sizeof(id), "%s|%s|%d", engine->model_name, cpu.name, cpu.logical_cpus);
+
+	// FNV-1a keeps the key short and free of characters the preferences file can't hold
+	unsigned int hash = 2166136261u;
+	for (const char *p = id; *p; p++) {
+		hash ^= (unsigned char) *p;
+		hash *= 16777619u;
+	}
+	snprintf(key, size, "tuned_threads_%08x", hash);
+}
+
+// Threads per decode before tuning: one per performance core, since SMT
+// siblings and efficiency cores tend to slow whisper down, capped at 8
+static int default_threads(void) {
+	utils_cpu_info_t cpu;
+	utils_get_cpu_info(&cpu);
+
+	int n_threads = cpu.performance_cores;
+	if (n_threads == cpu.logical_cpus && n_threads > 1) {
+		n_threads--;// Leave one core for the system
+	}
+	return std::max(1, std::min(n_threads, 8));
+}
+
+// whisper.cpp's CPU backend runs its graphs on the OpenMP thread team, which
+// persists across whisper_full calls and parks between dictations. The OpenMP
+// runtime reads its binding settings only when the process starts, so pinning
+// the team to physical cores takes OMP_PROC_BIND=close and OMP_PLACES=cores
+// exported before launch; report them if they were.
+static void log_compute_thread_binding(void) {
+	static std::atomic<bool> logged(false);
+	const char *bind = getenv("OMP_PROC_BIND");
+	const char *places = getenv("OMP_PLACES");
+	if ((bind || places) && !logged.exchange(true)) {
+		log_info("🧵 Inference thread binding from the environment: OMP_PROC_BIND=%s, OMP_PLACES=%s",
+				 bind ? bind : "-", places ? places : "-");
+	}
+}
+
+// Time a trivial graph on n_threads. Nearly all of it is the cost of getting
+// the compute threads going, which every graph whisper computes pays as well.
+static double thread_startup_ms(int n_threads) {
+	struct ggml_init_params params = {1024 * 1024, NULL, false};
+	struct ggml_context *gctx = ggml_init(params);
+	if (!gctx) {
+		return -1.0;
+	}
+
+	struct ggml_tensor *input = ggml_new_tensor_1d(gctx, GGML_TYPE_F32, 4096);
+	memset(input->data, 0, ggml_nbytes(input));
+	struct ggml_cgraph *graph = ggml_new_graph(gctx);
+	ggml_build_forward_expand(graph, ggml_scale(gctx, input, 2.0f));
+
+	double start = utils_now();
+	ggml_graph_compute_with_ctx(gctx, graph, n_threads);
+	double duration = utils_now() - start;
+
+	ggml_free(gctx);
+	return duration * 1000.0;
+}
+
+TranscriptionEngine *transcription_engine_create(const char *model_path, int n_states) {
+	if (!model_path) {
+		log_error("ERROR: No model path provided");
+		return NULL;
+	}
+	if (n_states < 1) {
+		n_states = 1;
 	}
 
 	// Disable whisper/ggml logging
-	log_debug("Setting whisper logging callbacks - thread=%p", utils_thread_id());
 	ggml_log_set(null_log_callback, NULL);
 	whisper_log_set(null_log_callback, NULL);
 
-	log_debug("About to load whisper model - thread=%p", utils_thread_id());
+	log_compute_thread_binding();
+
 	log_info("🧠 Loading Whisper model: %s", model_path);
 
 	double start = utils_now();
@@ -90,35 +407,165 @@ int transcription_init(const char *model_path) {
 			 cparams.flash_attn ? "YES" : "NO",
 			 cparams.use_gpu ? "YES" : "NO");
 
-	log_debug("About to call whisper_init_from_file_with_params - thread=%p", utils_thread_id());
-	ctx = whisper_init_from_file_with_params(model_path, cparams);
-	log_debug("whisper_init_from_file_with_params returned ctx=%p - thread=%p", ctx, utils_thread_id());
-
-	double duration = utils_now() - start;
-
+	// Weights only; decoder states are created below
+	struct whisper_context *ctx = whisper_init_from_file_with_params_no_state(model_path, cparams);
 	if (!ctx) {
-		log_debug("whisper_init failed - thread=%p", utils_thread_id());
 		log_error("ERROR: Failed to initialize Whisper from model file: %s", model_path);
-		utils_mutex_unlock(ctx_mutex);
-		return -1;
+		return NULL;
 	}
 
-	log_debug("whisper_init success, about to log completion - thread=%p", utils_thread_id());
-	log_info("✅ Whisper initialized successfully (took %.0f ms)", duration * 1000.0);
+	log_info("✅ Whisper initialized successfully (took %.0f ms)", (utils_now() - start) * 1000.0);
 	log_info("⚡ Requested - Flash Attention: %s, GPU: %s",
 			 cparams.flash_attn ? "enabled" : "disabled",
 			 cparams.use_gpu ? "enabled" : "disabled");
 
-	// Check and log VAD status during initialization
+	TranscriptionEngine *engine = new TranscriptionEngine();
+	engine->ctx = ctx;
+	engine->pending = 0;
+	engine->waiters = 0;
+	engine->stopping = false;
+	const char *slash = strrchr(model_path, '/');
+	const char *backslash = strrchr(model_path, '\\');
+	const char *model_name = std::max(slash, backslash);
+	snprintf(engine->model_name, sizeof(engine->model_name), "%s", model_name ? model_name + 1 : model_path);
+
+	double total_mb = 0.0;
+	for (int i = 0; i < n_states; i++) {
+		double state_start = utils_now();
+		double state_mb = 0.0;
+		whisper_log_set(state_memory_log_callback, &state_mb);
+		struct whisper_state *state = whisper_init_state(ctx);
+		whisper_log_set(null_log_callback, NULL);
+
+		if (!state) {
+			log_error("ERROR: Failed to create decoder state %d of %d", i + 1, n_states);
+			break;
+		}
+		engine->states.push_back(state);
+		engine->in_use.push_back(false);
+		total_mb += state_mb;
+		log_info("🧠 Decoder state %d: %.1f MB (took %.0f ms)", i + 1, state_mb, (utils_now() - state_start) * 1000.0);
+	}
+
+	if (engine->states.empty()) {
+		whisper_free(ctx);
+		delete engine;
+		return NULL;
+	}
+
+	// Thread count tuned for this model and CPU, or a topology-based guess
+	char key[64];
+	tuning_key(engine, key, sizeof(key));
+	int tuned = preferences_get_int(key, 0);
+	transcription_engine_set_threads(engine, tuned > 0 ? tuned : default_threads());
+
+	log_info("🧠 Transcription engine ready: %d decoder states, %.1f MB of state memory, %d inference threads%s",
+			 (int) engine->states.size(), total_mb, engine->n_threads.load(), tuned > 0 ? " (tuned)" : "");
+
+	// A persistent thread team only pays the first figure once; threads
+	// created per graph pay the second on every graph of every decode
+	double first_ms = thread_startup_ms(engine->n_threads);
+	double again_ms = thread_startup_ms(engine->n_threads);
+	log_info("🧵 Compute thread start-up for %d threads: %.2f ms first graph, %.2f ms per graph after",
+			 engine->n_threads.load(), first_ms, again_ms);
+	return engine;
+}
+
+void transcription_engine_free(TranscriptionEngine *engine) {
+	if (!engine) {
+		return;
+	}
+
+	engine->stopping = true;
+	if (engine->warmup_thread.joinable()) {
+		engine->warmup_thread.join();
+	}
+
+	{
+		// Let running transcriptions finish first
+		std::unique_lock<std::mutex> lock(engine->pool_mutex);
+		while (engine->pending > 0) {
+			engine->pool_cv.wait(lock);
+		}
+	}
+
+	for (size_t i = 0; i < engine->states.size(); i++) {
+		whisper_free_state(engine->states[i]);
+	}
+	whisper_free(engine->ctx);
+	delete engine;
+}
+
+int transcription_engine_n_mels(const TranscriptionEngine *engine) {
+	return engine ? whisper_model_n_mels(engine->ctx) : 0;
+}
+
+int transcription_engine_n_states(const TranscriptionEngine *engine) {
+	return engine ? (int) engine->states.size() : 0;
+}
+
+int transcription_engine_get_threads(const TranscriptionEngine *engine) {
+	return engine ? engine->n_threads.load() : 0;
+}
+
+void transcription_engine_set_threads(TranscriptionEngine *engine, int n_threads) {
+	if (engine) {
+		engine->n_threads = std::max(1, n_threads);
+	}
+}
+
+TranscriptionEngine *transcription_get_engine(void) {
+	ensure_mutex_initialized();
+	utils_mutex_lock(ctx_mutex);
+	TranscriptionEngine *engine = g_engine;
+	utils_mutex_unlock(ctx_mutex);
+	return engine;
+}
+
+int transcription_init(const char *model_path) {
+	ensure_mutex_initialized();
+
+	log_debug("transcription_init() ENTRY - thread=%p, model_path=%s",
+		   utils_thread_id(), model_path ? model_path : "NULL");
+
+	if (!model_path) {
+		log_error("ERROR: No model path provided");
+		return -1;
+	}
+
+	utils_mutex_lock(ctx_mutex);
+	log_debug("Acquired transcription mutex - thread=%p", utils_thread_id());
+
+	// Check if already initialized
+	if (g_engine != NULL) {
+		log_debug("Already initialized, returning 0 - thread=%p", utils_thread_id());
+		log_info("Transcription already initialized");
+		utils_mutex_unlock(ctx_mutex);
+		return 0;
+	}
+
+	// More states allow concurrent transcriptions at the cost of memory per state
+	int n_states = preferences_get_int("transcription_states", DEFAULT_STATES);
+	g_engine = transcription_engine_create(model_path, n_states);
+	if (!g_engine) {
+		utils_mutex_unlock(ctx_mutex);
+		return -1;
+	}
+
+	// Load the VAD model now so dictations don't pay for it
 	bool vad_enabled = preferences_get_bool("vad_enabled", true);
 	const char *vad_model_path = models_get_vad_path();
-	if (vad_enabled && vad_model_path) {
+	std::unique_lock<std::mutex> vad_lock(vad_mutex);
+	if (vad_enabled && vad_model_path && ensure_vad_context()) {
 		log_info("🎙️ VAD (Voice Activity Detection): ENABLED");
+	} else if (vad_enabled && vad_model_path) {
+		log_info("🎙️ VAD (Voice Activity Detection): DISABLED (model failed to load)");
 	} else if (!vad_enabled) {
 		log_info("🎙️ VAD (Voice Activity Detection): DISABLED (set vad_enabled=true in config or use menu to enable)");
 	} else {
 		log_info("🎙️ VAD (Voice Activity Detection): DISABLED (model not found)");
 	}
+	vad_lock.unlock();
 
 	log_debug("Releasing transcription mutex and returning 0 - thread=%p", utils_thread_id());
 	utils_mutex_unlock(ctx_mutex);
@@ -126,103 +573,760 @@ int transcription_init(const char *model_path) {
 }
 
 
-char *transcription_process(const float *audio_data, int n_samples, int sample_rate) {
-	(void) sample_rate;// Currently unused
-	ensure_mutex_initialized();
-	
-	log_debug("transcription_process() ENTRY - thread=%p", utils_thread_id());
-	
-	if (audio_data == NULL || n_samples <= 0) {
-		log_error("ERROR: Invalid parameters for transcription");
-		return NULL;
+// Decoding parameters shared by every transcription entry point.
+// VAD is applied beforehand with the persistent context (see extract_speech),
+// so whisper's own per-call VAD pass stays off.
+static struct whisper_full_params make_full_params(const TranscriptionEngine *engine, const char *language,
+												   const DecodeProfile &profile) {
+	struct whisper_full_params wparams =
+		whisper_full_default_params(profile.beam_search ? WHISPER_SAMPLING_BEAM_SEARCH : WHISPER_SAMPLING_GREEDY);
+	wparams.print_realtime = false;
+	wparams.print_progress = false;
+	wparams.print_timestamps = false;
+	wparams.print_special = false;
+	wparams.translate = false;
+	wparams.language = language;// Use configured language
+	wparams.n_threads = engine->n_threads.load();
+	wparams.offset_ms = 0;
+	wparams.duration_ms = 0;
+
+	wparams.vad = false;
+
+	wparams.greedy.best_of = profile.beam_size;
+	wparams.beam_search.beam_size = profile.beam_size;
+	wparams.temperature_inc = profile.temperature_inc;
+	wparams.entropy_thold = profile.entropy_thold;
+	wparams.logprob_thold = profile.logprob_thold;
+	wparams.max_tokens = profile.max_tokens;
+
+	return wparams;
+}
+
+typedef struct {
+	int src_start;// Offset in the original audio
+	int dst_start;// Offset in the gathered speech audio
+	int length;
+} SpeechSpan;
+
+// Cheap stand-in for VAD: does the clip have enough voiced 20 ms frames?
+static bool has_voiced_audio(const float *audio, int n_samples) {
+	int voiced = 0;
+	for (int start = 0; start + GATE_FRAME_SAMPLES <= n_samples; start += GATE_FRAME_SAMPLES) {
+		const float *frame = audio + start;
+		float mean = 0.0f;
+		for (int i = 0; i < GATE_FRAME_SAMPLES; i++) {
+			mean += frame[i];
+		}
+		mean /= GATE_FRAME_SAMPLES;// Crossings are counted around the DC offset
+
+		float energy = 0.0f;
+		int crossings = 0;
+		bool above = frame[0] > mean;
+		for (int i = 0; i < GATE_FRAME_SAMPLES; i++) {
+			const float x = frame[i] - mean;
+			energy += x * x;
+			if ((x > 0.0f) != above) {
+				above = x > 0.0f;
+				crossings++;
+			}
+		}
+
+		const float rms = sqrtf(energy / GATE_FRAME_SAMPLES);
+		const float zcr = (float) crossings / GATE_FRAME_SAMPLES;
+		if (rms >= GATE_MIN_RMS && zcr <= GATE_MAX_ZCR && ++voiced >= GATE_MIN_FRAMES) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Count a clip that never reached whisper
+static void count_skipped_clip(int n_samples) {
+	g_clips_skipped++;
+	g_skipped_audio_ms += (long long) n_samples * 1000 / SAMPLE_RATE;
+}
+
+// Run VAD with the persistent context and gather the speech spans back to
+// back. Returns false when VAD is disabled or unavailable, in which case the
+// audio should be used as is; an empty span list means no speech.
+static bool extract_speech(const float *audio_data, int n_samples, std::vector<float> &speech,
+						   std::vector<SpeechSpan> &spans) {
+	if (!preferences_get_bool("vad_enabled", true)) {
+		log_info("VAD disabled in preferences");
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(vad_mutex);
+	if (!ensure_vad_context()) {
+		log_info("VAD model not found, running without voice activity detection");
+		return false;
+	}
+
+	double start = utils_now();
+	struct whisper_vad_segments *segments = whisper_vad_segments_from_samples(vad_ctx, vad_current_params(),
+																			  audio_data, n_samples);
+	if (!segments) {
+		log_error("ERROR: VAD failed, running without voice activity detection");
+		return false;
+	}
+
+	const int n_segments = whisper_vad_segments_n_segments(segments);
+	for (int i = 0; i < n_segments; ++i) {
+		// VAD timestamps are in units of 10 ms
+		int span_start = (int) (whisper_vad_segments_get_segment_t0(segments, i) * (SAMPLE_RATE / 100));
+		int span_end = (int) (whisper_vad_segments_get_segment_t1(segments, i) * (SAMPLE_RATE / 100));
+		span_start = std::max(span_start, spans.empty() ? 0 : spans.back().src_start + spans.back().length);
+		span_end = std::min(span_end, n_samples);
+		if (span_end <= span_start) {
+			continue;
+		}
+
+		if (!speech.empty()) {
+			speech.insert(speech.end(), VAD_SPEECH_GAP_SAMPLES, 0.0f);
+		}
+		SpeechSpan span = {span_start, (int) speech.size(), span_end - span_start};
+		spans.push_back(span);
+		speech.insert(speech.end(), audio_data + span_start, audio_data + span_end);
+	}
+	whisper_vad_free_segments(segments);
+
+	log_info("🎙️ VAD kept %.2f of %.2f seconds in %d speech spans (took %.0f ms)",
+			 (float) speech.size() / SAMPLE_RATE, (float) n_samples / SAMPLE_RATE, (int) spans.size(),
+			 (utils_now() - start) * 1000.0);
+	return true;
+}
+
+// Map a timestamp in the gathered speech audio back to the original audio
+static int speech_to_source_ms(const std::vector<SpeechSpan> &spans, int ms) {
+	const int pos = ms * (SAMPLE_RATE / 1000);
+	for (size_t i = spans.size(); i-- > 0;) {
+		if (pos >= spans[i].dst_start) {
+			int offset = std::min(pos - spans[i].dst_start, spans[i].length);
+			return (spans[i].src_start + offset) / (SAMPLE_RATE / 1000);
+		}
+	}
+	return ms;
+}
+
+// Encoder context for a clip: the smallest bucket that holds it, or 0 for
+// whisper's full 30 s window
+static int choose_audio_ctx(const TranscriptionEngine *engine, int n_samples) {
+	if (preferences_get_bool("full_audio_context", false)) {
+		return 0;
+	}
+
+	const int full_ctx = whisper_n_audio_ctx(engine->ctx);
+	const int needed = (int) (((long long) n_samples * AUDIO_CTX_PER_SECOND + SAMPLE_RATE - 1) / SAMPLE_RATE) +
+					   AUDIO_CTX_MARGIN;
+	for (size_t i = 0; i < sizeof(AUDIO_CTX_BUCKETS) / sizeof(AUDIO_CTX_BUCKETS[0]); i++) {
+		if (AUDIO_CTX_BUCKETS[i] >= full_ctx) {
+			break;
+		}
+		if (needed <= AUDIO_CTX_BUCKETS[i]) {
+			return AUDIO_CTX_BUCKETS[i];
+		}
+	}
+	return 0;
+}
+
+// Check a reduced-context decode for signs that the shortened window hurt it.
+// Returns the reason, or NULL if the result looks fine.
+static const char *reduced_context_problem(const TranscriptionEngine *engine, struct whisper_state *state,
+										   int n_samples, bool expect_speech) {
+	const int n_segments = whisper_full_n_segments_from_state(state);
+	if (n_segments == 0) {
+		return expect_speech ? "empty" : NULL;
+	}
+
+	const int duration_ms = (int) ((long long) n_samples * 1000 / SAMPLE_RATE);
+	const int end_ms = (int) whisper_full_get_segment_t1_from_state(state, n_segments - 1) * 10;
+	if (duration_ms - end_ms > MAX_TAIL_GAP_MS) {
+		return "truncated";
+	}
+
+	const whisper_token eot = whisper_token_eot(engine->ctx);
+	size_t n_chars = 0;
+	float p_sum = 0.0f;
+	int n_tokens = 0;
+	for (int i = 0; i < n_segments; i++) {
+		const char *text = whisper_full_get_segment_text_from_state(state, i);
+		n_chars += text ? strlen(text) : 0;
+
+		const int segment_tokens = whisper_full_n_tokens_from_state(state, i);
+		for (int j = 0; j < segment_tokens; j++) {
+			if (whisper_full_get_token_id_from_state(state, i, j) >= eot) {
+				continue;// Special and timestamp tokens
+			}
+			p_sum += whisper_full_get_token_p_from_state(state, i, j);
+			n_tokens++;
+		}
+	}
+
+	if (n_tokens > 0 && p_sum / n_tokens < MIN_AVG_TOKEN_P) {
+		return "low-confidence";
+	}
+	if (n_chars > (size_t) (MAX_CHARS_PER_SECOND * n_samples / SAMPLE_RATE) + 20) {
+		return "repetitive";
+	}
+	return NULL;
+}
+
+// Take a free decoder state, waiting while all of them are busy unless
+// wait is false (then -1 is returned).
+// The caller must have counted itself in engine->pending.
+static int acquire_state(TranscriptionEngine *engine, bool wait) {
+	std::unique_lock<std::mutex> lock(engine->pool_mutex);
+	bool waiting = false;
+	for (;;) {
+		for (size_t i = 0; i < engine->in_use.size(); i++) {
+			if (!engine->in_use[i]) {
+				engine->in_use[i] = true;
+				if (waiting) {
+					engine->waiters--;
+				}
+				return (int) i;
+			}
+		}
+		if (!wait) {
+			return -1;
+		}
+		if (!waiting) {
+			waiting = true;
+			engine->waiters++;
+		}
+		engine->pool_cv.wait(lock);
+	}
+}
+
+// Drop a reference counted in engine->pending
+static void release_engine(TranscriptionEngine *engine) {
+	{
+		std::lock_guard<std::mutex> lock(engine->pool_mutex);
+		engine->pending--;
+	}
+	engine->pool_cv.notify_all();
+}
+
+static void release_state(TranscriptionEngine *engine, int index) {
+	{
+		std::lock_guard<std::mutex> lock(engine->pool_mutex);
+		engine->in_use[index] = false;
+		engine->pending--;
+	}
+	engine->pool_cv.notify_all();
+}
+
+// One transcription request; its long-form pieces share the cancel token and deadline
+typedef struct {
+	unsigned generation;// Cancelled once transcription_cancel() moves g_cancel_generation on
+	double deadline;    // utils_now() time to give up at, 0 for none
+	int parallel;       // Decodes the job runs at once (its long-form pieces)
+	bool *abort;        // Caller's flag that stops this job alone, or NULL; atomic access
+} Job;
+
+static Job begin_job(void) {
+	Job job;
+	job.generation = g_cancel_generation.load();
+	int budget_ms = preferences_get_int("transcription_deadline_ms", 0);
+	job.deadline = budget_ms > 0 ? utils_now() + budget_ms / 1000.0 : 0.0;
+	job.parallel = 1;
+	job.abort = NULL;
+	return job;
+}
+
+static bool job_stopped(const Job &job) {
+	return g_cancel_generation.load() != job.generation || (job.abort && utils_atomic_read_bool(job.abort)) ||
+		   (job.deadline > 0.0 && utils_now() >= job.deadline);
+}
+
+// Watches the tokens of one whisper run for repetition loops. whisper may
+// call the logits callback from several threads when it runs more than one
+// decoder, hence the mutex.
+typedef struct {
+	const Job *job;
+	int max_tokens;// Text tokens allowed per window
+	std::mutex mutex;
+	std::atomic<bool> tripped;
+	std::vector<whisper_token> kept;// Text tokens of the window before the loop
+	const char *reason;
+} LoopMonitor;
+
+static bool decode_abort_callback(void *user_data) {
+	LoopMonitor *monitor = (LoopMonitor *) user_data;
+	return monitor->tripped || job_stopped(*monitor->job);
+}
+
+static void loop_logits_callback(struct whisper_context *ctx, struct whisper_state *state,
+								 const whisper_token_data *tokens, int n_tokens, float *logits, void *user_data) {
+	(void) state;
+	(void) logits;
+	LoopMonitor *monitor = (LoopMonitor *) user_data;
+	if (monitor->tripped) {
+		return;
+	}
+
+	const whisper_token eot = whisper_token_eot(ctx);
+	std::vector<whisper_token> text;
+	text.reserve(n_tokens);
+	for (int i = 0; i < n_tokens; i++) {
+		if (tokens[i].id < eot) {
+			text.push_back(tokens[i].id);
+		}
+	}
+
+	const int n_text = (int) text.size();
+	int keep = -1;
+	const char *reason = NULL;
+	if (n_text > monitor->max_tokens) {
+		keep = monitor->max_tokens;
+		reason = "too many tokens";
+	}
+	for (int n = 1; keep < 0 && n <= LOOP_MAX_NGRAM && n * LOOP_MIN_REPEATS <= n_text; n++) {
+		// How often the last n tokens occur back to back at the end
+		int repeats = 1;
+		while ((repeats + 1) * n <= n_text &&
+			   std::equal(text.end() - n, text.end(), text.end() - (repeats + 1) * n)) {
+			repeats++;
+		}
+		if (repeats >= LOOP_MIN_REPEATS && repeats * n >= LOOP_MIN_SPAN) {
+			keep = n_text - (repeats - 1) * n;// The first occurrence stays
+			reason = "repetition";
+		}
+	}
+	if (keep < 0) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(monitor->mutex);
+	if (!monitor->tripped) {
+		monitor->kept.assign(text.begin(), text.begin() + keep);
+		monitor->reason = reason;
+		monitor->tripped = true;
+	}
+}
+
+// A finished whisper run; the state stays reserved until finish_decode()
+typedef struct {
+	TranscriptionEngine *engine;
+	int state_index;
+	struct whisper_state *state;
+	bool vad_applied;
+	bool no_speech;// Nothing to read: VAD found no speech, or the job stopped before whisper ran
+	bool aborted;  // Cancelled or out of time; the state holds the segments decoded so far
+	std::vector<SpeechSpan> spans;
+	std::string loop_tail;// Text of a window cut short by the loop monitor, after the state's segments
+	std::string alt_text; // Better-scoring text in the runner-up language; replaces the segments
+	int decoded_ms;       // Length of the audio whisper ran on
+} Decode;
+
+// The two most likely languages among the allowed ones, with probabilities
+// renormalized over that set
+typedef struct {
+	int lang_id[2];// -1 if there is no candidate
+	float p[2];
+} LanguageGuess;
+
+// Detect the language from the start of the audio (NULL if the state already
+// holds its spectrogram). Runs the encoder once, at whatever reduced window
+// the state last used, which is plenty for this.
+static bool detect_language(TranscriptionEngine *engine, struct whisper_state *state, const float *audio_data,
+							int n_samples, int n_threads, const std::vector<int> &allowed, LanguageGuess &guess) {
+	std::vector<float> probs(whisper_lang_max_id() + 1, 0.0f);
+	if ((audio_data && whisper_pcm_to_mel_with_state(engine->ctx, state, audio_data, n_samples, n_threads) != 0) ||
+		whisper_lang_auto_detect_with_state(engine->ctx, state, 0, n_threads, probs.data()) < 0) {
+		return false;
 	}
-	
+
+	float total = 0.0f;
+	guess.lang_id[0] = guess.lang_id[1] = -1;
+	guess.p[0] = guess.p[1] = 0.0f;
+	for (int id = 0; id < (int) probs.size(); id++) {
+		if (!allowed.empty() && std::find(allowed.begin(), allowed.end(), id) == allowed.end()) {
+			continue;
+		}
+		total += probs[id];
+		if (guess.lang_id[0] < 0 || probs[id] > guess.p[0]) {
+			guess.lang_id[1] = guess.lang_id[0];
+			guess.p[1] = guess.p[0];
+			guess.lang_id[0] = id;
+			guess.p[0] = probs[id];
+		} else if (guess.lang_id[1] < 0 || probs[id] > guess.p[1]) {
+			guess.lang_id[1] = id;
+			guess.p[1] = probs[id];
+		}
+	}
+	if (guess.lang_id[0] < 0 || total <= 0.0f) {
+		return false;
+	}
+	guess.p[0] /= total;
+	guess.p[1] /= total;
+	return true;
+}
+
+// Greedy decode in a given language from the encoder output whisper_full left
+// in the state, without timestamps. Returns the text and its mean token log
+// probability (over the text tokens and the end token), so two languages can
+// be compared on equal terms.
+static bool decode_language(TranscriptionEngine *engine, struct whisper_state *state, int lang_id, int n_threads,
+							int max_tokens, std::string &text, float &mean_logprob) {
+	struct whisper_context *ctx = engine->ctx;
+	const whisper_token eot = whisper_token_eot(ctx);
+	const int n_vocab = whisper_n_vocab(ctx);
+	whisper_token prompt[] = {whisper_token_sot(ctx), whisper_token_lang(ctx, lang_id), whisper_token_transcribe(ctx),
+							  whisper_token_not(ctx)};
+	const int n_prompt = (int) (sizeof(prompt) / sizeof(prompt[0]));
+	if (whisper_decode_with_state(ctx, state, prompt, n_prompt, 0, n_threads) != 0) {
+		return false;
+	}
+
+	int n_past = n_prompt;
+	double sum = 0.0;
+	int n = 0;
+	text.clear();
+	for (int step = 0; step <= max_tokens; step++) {
+		// One row of logits per decoded token; the prompt's last one predicts the first text token
+		const float *logits = whisper_get_logits_from_state(state) + (step == 0 ? (n_prompt - 1) * n_vocab : 0);
+		// Text tokens and, after the first one, the end token; nothing special
+		const int last = step > 0 ? eot : eot - 1;
+		whisper_token best = 0;
+		for (int id = 1; id <= last && id < n_vocab; id++) {
+			if (logits[id] > logits[best]) {
+				best = id;
+			}
+		}
+		double lse = 0.0;
+		for (int id = 0; id <= last && id < n_vocab; id++) {
+			lse += exp(logits[id] - logits[best]);
+		}
+		sum += -log(lse);// log softmax of the best token
+		n++;
+
+		if (best == eot) {
+			break;
+		}
+		const char *piece = whisper_token_to_str(ctx, best);
+		text += piece ? piece : "";
+		if (whisper_decode_with_state(ctx, state, &best, 1, n_past++, n_threads) != 0) {
+			return false;
+		}
+	}
+	mean_logprob = (float) (sum / n);
+	return true;
+}
+
+// run_decode() flags
+#define DECODE_SPLIT_WORDS 0x1// One segment per word
+#define DECODE_TOKENS 0x2     // Per-token timestamps
+#define DECODE_TEXT_ONLY 0x4  // Caller only reads the text, so another language may be tried without timestamps
+#define DECODE_DRAFT 0x8      // Default to the draft engine instead of the main one
+
+// The engine and settings a transcription runs with, copied under ctx_mutex
+typedef struct {
+	TranscriptionEngine *engine;// Counted in its pending until the decode is finished
+	char language[sizeof(g_language)];
+	std::vector<int> auto_languages;
+	DecodeProfile profile;
+} DecodeSetup;
+
+// Resolve the engine (the default one if NULL) and count the transcription in
+// its pending, so transcription_cleanup() waits for it. ctx_mutex is only held
+// for this; VAD and whisper run without it. Returns false if no model is loaded.
+static bool begin_decode(TranscriptionEngine *engine, int flags, DecodeSetup &setup) {
+	ensure_mutex_initialized();
 	utils_mutex_lock(ctx_mutex);
-	log_debug("Acquired transcription mutex for processing - thread=%p", utils_thread_id());
-	
-	if (ctx == NULL) {
-		log_debug("Context not available - thread=%p", utils_thread_id());
-		log_error("ERROR: Whisper not initialized");
+
+	if (!engine) {
+		engine = (flags & DECODE_DRAFT) ? g_draft_engine : g_engine;
+	}
+	if (engine == NULL) {
 		utils_mutex_unlock(ctx_mutex);
-		return NULL;
+		return false;
 	}
 
-	log_info("🧠 Transcribing %d audio samples (%.2f seconds) using language: %s\n",
-			 n_samples, (float) n_samples / 16000.0f, g_language);
+	setup.engine = engine;
+	memcpy(setup.language, g_language, sizeof(setup.language));
+	setup.auto_languages = g_auto_languages;
+	{
+		std::lock_guard<std::mutex> lock(engine->pool_mutex);
+		engine->pending++;
+	}
+	utils_mutex_unlock(ctx_mutex);
 
-	double total_start = utils_now();
+	setup.profile = load_profile(active_profile());
+	return true;
+}
 
-	// Set up whisper parameters
-	struct whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
-	wparams.print_realtime = false;
-	wparams.print_progress = false;
-	wparams.print_timestamps = false;
-	wparams.print_special = false;
-	wparams.translate = false;
-	wparams.language = g_language;// Use configured language
-	// Use optimal number of threads (leave some for system)
-	int n_threads = std::thread::hardware_concurrency();
-	if (n_threads > 1) {
-		n_threads = std::min(n_threads - 1, 8);// Leave one core for system, cap at 8
-	} else {
-		n_threads = 4;// Default fallback
+// Threads for a decode that just took its state: the engine's budget split
+// across the states in use, and across all pieces of a long-form job, which
+// start at nearly the same time
+static int decode_threads(TranscriptionEngine *engine, const Job &job) {
+	int busy = 0;
+	{
+		std::lock_guard<std::mutex> lock(engine->pool_mutex);
+		for (size_t i = 0; i < engine->in_use.size(); i++) {
+			busy += engine->in_use[i] ? 1 : 0;
+		}
+	}
+	busy = std::min(std::max(busy, job.parallel), (int) engine->states.size());
+	return std::max(1, engine->n_threads.load() / std::max(1, busy));
+}
+
+// Count one more transcription on an engine something already holds in pending
+static void retain_engine(TranscriptionEngine *engine) {
+	std::lock_guard<std::mutex> lock(engine->pool_mutex);
+	engine->pending++;
+}
+
+// VAD, then whisper on a free state of the setup's engine. Takes over the
+// pending reference the caller holds and never locks ctx_mutex, so it is safe
+// while transcription_cleanup() waits for the engine.
+// mel (may be NULL) is the audio's spectrogram if it was computed while recording.
+// A cancelled or late job stops early and still succeeds with what it has.
+// Returns false on error.
+static bool decode_with_setup(const DecodeSetup &setup, const float *audio_data, int n_samples, bool run_vad,
+							  const char *initial_prompt, int flags, const MelSpectrogram *mel, const Job &job,
+							  Decode &decode) {
+	TranscriptionEngine *engine = setup.engine;
+	const char *language = setup.language;
+	const DecodeProfile &profile = setup.profile;
+
+	// Reduce the audio to speech first
+	std::vector<float> speech;
+	decode.engine = engine;
+	decode.state_index = -1;
+	decode.state = NULL;
+	decode.aborted = false;
+	decode.loop_tail.clear();
+	decode.alt_text.clear();
+	decode.decoded_ms = 0;
+	decode.vad_applied = run_vad && extract_speech(audio_data, n_samples, speech, decode.spans);
+	decode.no_speech = decode.vad_applied && decode.spans.empty();
+	if (!decode.vad_applied && run_vad && preferences_get_bool("speech_gate", true)) {
+		decode.no_speech = !has_voiced_audio(audio_data, n_samples);
+		if (decode.no_speech) {
+			log_info("🤫 No voiced audio in %.2f s, skipping whisper", (float) n_samples / SAMPLE_RATE);
+		}
+	}
+	if (decode.no_speech) {
+		release_engine(engine);
+		count_skipped_clip(n_samples);
+		return true;
+	}
+	if (decode.vad_applied) {
+		audio_data = speech.data();
+		n_samples = (int) speech.size();
+	}
+	decode.decoded_ms = (int) ((long long) n_samples * 1000 / SAMPLE_RATE);
+
+	double wait_start = utils_now();
+	decode.state_index = acquire_state(engine, true);
+	decode.state = engine->states[decode.state_index];
+	double wait_duration = utils_now() - wait_start;
+	if (wait_duration > 0.001) {
+		log_info("⏱️  Waited %.0f ms for a free decoder state", wait_duration * 1000.0);
+	}
+	if (job_stopped(job)) {
+		log_info("⏹️  Transcription cancelled before whisper started");
+		decode.no_speech = true;
+		decode.aborted = true;
+		return true;
+	}
+
+	struct whisper_full_params wparams = make_full_params(engine, language, profile);
+	wparams.n_threads = decode_threads(engine, job);
+	wparams.initial_prompt = initial_prompt;
+	if (flags & DECODE_TEXT_ONLY) {
+		// Timestamp tokens cost decode steps nobody reads here
+		wparams.no_timestamps = profile.no_timestamps;
+		wparams.single_segment = profile.single_segment;
+	}
+	if (flags & DECODE_SPLIT_WORDS) {
+		// One segment per word, each with its own timestamps
+		wparams.token_timestamps = true;
+		wparams.max_len = 1;
+		wparams.split_on_word = true;
+	}
+	if (flags & DECODE_TOKENS) {
+		wparams.token_timestamps = true;
+	}
+
+	// Short clips don't need the encoder to process a padded 30 s window
+	wparams.audio_ctx = profile.audio_ctx < 0 ? choose_audio_ctx(engine, n_samples) : profile.audio_ctx;
+	if (wparams.audio_ctx >= whisper_n_audio_ctx(engine->ctx)) {
+		wparams.audio_ctx = 0;
+	}
+
+	// With the spectrogram from the recording, whisper starts at the encoder.
+	// Only for text: whisper's token timestamps need the samples.
+	const float *whisper_audio = audio_data;
+	int whisper_samples = n_samples;
+	if (mel && !decode.vad_applied && (flags & DECODE_TEXT_ONLY) && mel->n_samples == n_samples &&
+		mel->n_mel == whisper_model_n_mels(engine->ctx) &&
+		whisper_set_mel_with_state(engine->ctx, decode.state, mel->data, mel->n_len, mel->n_mel) == 0) {
+		whisper_audio = NULL;
+		whisper_samples = 0;
+		wparams.duration_ms = decode.decoded_ms;// Otherwise the 30 s of padding counts as audio
+	}
+
+	// Let "auto" choose among the user's languages only
+	LanguageGuess guess = {{-1, -1}, {0.0f, 0.0f}};
+	if (strcmp(language, "auto") == 0 && whisper_is_multilingual(engine->ctx) &&
+		detect_language(engine, decode.state, whisper_audio, n_samples, wparams.n_threads, setup.auto_languages,
+						guess)) {
+		wparams.language = whisper_lang_str(guess.lang_id[0]);
+		log_info("🌐 Detected language: %s (%.0f%%, next %s %.0f%%)", wparams.language, guess.p[0] * 100.0f,
+				 guess.lang_id[1] >= 0 ? whisper_lang_str(guess.lang_id[1]) : "-", guess.p[1] * 100.0f);
+		if (whisper_audio && (flags & DECODE_TEXT_ONLY)) {
+			// Detection left the spectrogram in the state; don't compute it again
+			whisper_audio = NULL;
+			whisper_samples = 0;
+			wparams.duration_ms = decode.decoded_ms;
+		}
+	}
+
+	LoopMonitor monitor;
+	monitor.job = &job;
+	monitor.max_tokens = MAX_TOKENS_PER_SECOND * std::min(decode.decoded_ms / 1000, 30) + MAX_TOKENS_SLACK;
+	monitor.tripped = false;
+	monitor.reason = NULL;
+	wparams.abort_callback = decode_abort_callback;
+	wparams.abort_callback_user_data = &monitor;
+	wparams.logits_filter_callback = loop_logits_callback;
+	wparams.logits_filter_callback_user_data = &monitor;
+
+	double whisper_start = utils_now();
+	int whisper_result = whisper_full_with_state(engine->ctx, decode.state, wparams, whisper_audio, whisper_samples);
+	double whisper_duration = utils_now() - whisper_start;
+
+	if (whisper_result != 0 && monitor.tripped && wparams.audio_ctx > 0 && !job_stopped(job)) {
+		// The shortened window can cause loops; give the full one a chance
+		log_info("🔁 Reduced-context decode stopped (%s), re-running at full context", monitor.reason);
+		monitor.tripped = false;
+		monitor.kept.clear();
+		wparams.audio_ctx = 0;
+		whisper_result = whisper_full_with_state(engine->ctx, decode.state, wparams, whisper_audio, whisper_samples);
+		whisper_duration = utils_now() - whisper_start;
+	}
+
+	log_info("⏱️  Whisper inference on %.2f seconds took: %.0f ms (%s, state %d, %d threads, audio_ctx %d%s)\n",
+			 (float) n_samples / SAMPLE_RATE, whisper_duration * 1000.0, profile.name, decode.state_index + 1,
+			 wparams.n_threads, wparams.audio_ctx ? wparams.audio_ctx : whisper_n_audio_ctx(engine->ctx),
+			 whisper_audio ? "" : ", precomputed mel");
+
+	if (whisper_result != 0 && job_stopped(job)) {
+		// Segments of the 30 s windows that finished are still in the state
+		log_info("⏹️  Transcription %s after %.0f ms, keeping %d finished segments",
+				 job.deadline > 0.0 && utils_now() >= job.deadline ? "hit its deadline" : "cancelled",
+				 whisper_duration * 1000.0, whisper_full_n_segments_from_state(decode.state));
+		decode.aborted = true;
+		return true;
+	}
+
+	if (whisper_result != 0 && monitor.tripped) {
+		// Keep the finished windows and the text before the loop
+		for (size_t i = 0; i < monitor.kept.size(); i++) {
+			const char *piece = whisper_token_to_str(engine->ctx, monitor.kept[i]);
+			decode.loop_tail += piece ? piece : "";
+		}
+		g_loops_stopped++;
+		log_info("🔁 Stopped decoding (%s) after %.0f ms, kept %d tokens of the window", monitor.reason,
+				 whisper_duration * 1000.0, (int) monitor.kept.size());
+		return true;
+	}
+
+	if (whisper_result == 0 && wparams.audio_ctx > 0) {
+		const char *problem = reduced_context_problem(engine, decode.state, n_samples, decode.vad_applied);
+		if (problem) {
+			wparams.audio_ctx = 0;
+			whisper_start = utils_now();
+			whisper_result = whisper_full_with_state(engine->ctx, decode.state, wparams, whisper_audio, whisper_samples);
+			log_info("🔁 Reduced-context result looked %s, re-ran at full context (took %.0f ms)", problem,
+					 (utils_now() - whisper_start) * 1000.0);
+			if (whisper_result != 0 && job_stopped(job)) {
+				decode.aborted = true;
+				return true;
+			}
+		}
+	}
+
+	if (whisper_result != 0) {
+		log_error("ERROR: Failed to run whisper transcription\n");
+		release_state(engine, decode.state_index);
+		return false;
 	}
-	wparams.n_threads = n_threads;
-	wparams.offset_ms = 0;
-	wparams.duration_ms = 0;
 
-	// Configure VAD (Voice Activity Detection)
-	bool vad_enabled = preferences_get_bool("vad_enabled", true);
-	const char *vad_model_path = models_get_vad_path();
-	if (vad_enabled && vad_model_path) {
-		wparams.vad = true;
-		wparams.vad_model_path = vad_model_path;
-		wparams.vad_params = whisper_vad_default_params();
-		log_info("VAD enabled with model: %s", vad_model_path);
-	} else {
-		wparams.vad = false;
-		if (!vad_enabled) {
-			log_info("VAD disabled in preferences");
-		} else {
-			log_info("VAD model not found, running without voice activity detection");
+	// Unsure between two languages: greedily decode both from the same encoder
+	// output and keep the runner-up's text if the model is more confident in
+	// it. Only when whisper encoded a single window, which the end of its last
+	// segment shows.
+	const int n_segments = whisper_full_n_segments_from_state(decode.state);
+	const int end_ms =
+		n_segments > 0 ? (int) whisper_full_get_segment_t1_from_state(decode.state, n_segments - 1) * 10 : 0;
+	if ((flags & DECODE_TEXT_ONLY) && guess.lang_id[1] >= 0 && guess.p[0] < LANG_MIN_CONFIDENCE &&
+		n_samples <= CHUNK_MAX_SAMPLES && n_segments > 0 && decode.decoded_ms - end_ms < 1000 && !job_stopped(job)) {
+		double alt_start = utils_now();
+		std::string text;
+		std::string alt_text;
+		float score = -INFINITY;
+		float alt_score = -INFINITY;
+		if (decode_language(engine, decode.state, guess.lang_id[0], wparams.n_threads, monitor.max_tokens, text,
+							score) &&
+			decode_language(engine, decode.state, guess.lang_id[1], wparams.n_threads, monitor.max_tokens, alt_text,
+							alt_score) &&
+			alt_score > score) {
+			decode.alt_text = alt_text;
 		}
+		log_info("🌐 Decoded as %s and %s in %.0f ms: mean logprob %.2f vs %.2f, keeping %s", wparams.language,
+				 whisper_lang_str(guess.lang_id[1]), (utils_now() - alt_start) * 1000.0, score, alt_score,
+				 decode.alt_text.empty() ? wparams.language : whisper_lang_str(guess.lang_id[1]));
 	}
 
-	// Run transcription
-	double whisper_start = utils_now();
-	int whisper_result = whisper_full(ctx, wparams, audio_data, n_samples);
-	double whisper_duration = utils_now() - whisper_start;
+	return true;
+}
 
-	log_info("⏱️  Whisper inference took: %.0f ms\n", whisper_duration * 1000.0);
+// decode_with_setup() on the engine (the default engine if NULL)
+static bool run_decode(TranscriptionEngine *engine, const float *audio_data, int n_samples, bool run_vad,
+					   const char *initial_prompt, int flags, const MelSpectrogram *mel, const Job &job,
+					   Decode &decode) {
+	if (audio_data == NULL || n_samples <= 0) {
+		log_error("ERROR: Invalid parameters for transcription");
+		return false;
+	}
 
-	if (whisper_result != 0) {
-		log_error("ERROR: Failed to run whisper transcription\n");
-		return NULL;
+	DecodeSetup setup;
+	if (!begin_decode(engine, flags, setup)) {
+		log_error("ERROR: Whisper not initialized");
+		return false;
 	}
+	return decode_with_setup(setup, audio_data, n_samples, run_vad, initial_prompt, flags, mel, job, decode);
+}
 
-	// Get transcription result
-	const int n_segments = whisper_full_n_segments(ctx);
-	if (n_segments == 0) {
-		log_info("⚠️  No speech detected\n");
-		char *empty_result = (char *) malloc(1);
-		if (empty_result) {
-			empty_result[0] = '\0';
-		}
-		return empty_result;
+static void finish_decode(Decode &decode) {
+	if (decode.state_index >= 0) {
+		release_state(decode.engine, decode.state_index);
+		decode.state_index = -1;
+		decode.state = NULL;
+	}
+}
+
+// Concatenate all segment texts of a decode
+static char *collect_segment_text(const Decode &decode) {
+	if (!decode.alt_text.empty()) {
+		return utils_strdup(decode.alt_text.c_str());
 	}
 
+	const int n_segments = whisper_full_n_segments_from_state(decode.state);
+
 	// Calculate total length needed
-	size_t total_len = 0;
+	size_t total_len = decode.loop_tail.size() + 1;
 	for (int i = 0; i < n_segments; ++i) {
-		const char *text = whisper_full_get_segment_text(ctx, i);
+		const char *text = whisper_full_get_segment_text_from_state(decode.state, i);
 		if (text) {
 			total_len += strlen(text);
 			if (i > 0) total_len++;// Space separator
 		}
 	}
 
-	// Allocate buffer with extra space for processing and trailing space
-	char *result = (char *) malloc(total_len + 2);// +1 for null terminator, +1 for trailing space
+	char *result = (char *) malloc(total_len + 1);
 	if (!result) {
 		log_error("ERROR: Failed to allocate memory for transcription\n");
 		return NULL;
@@ -231,7 +1335,7 @@ char *transcription_process(const float *audio_data, int n_samples, int sample_r
 	// Concatenate all segments
 	result[0] = '\0';
 	for (int i = 0; i < n_segments; ++i) {
-		const char *text = whisper_full_get_segment_text(ctx, i);
+		const char *text = whisper_full_get_segment_text_from_state(decode.state, i);
 		if (text) {
 			if (strlen(result) > 0) {
 				strcat(result, " ");
@@ -239,6 +1343,28 @@ char *transcription_process(const float *audio_data, int n_samples, int sample_r
 			strcat(result, text);
 		}
 	}
+	if (!decode.loop_tail.empty()) {
+		if (strlen(result) > 0) {
+			strcat(result, " ");
+		}
+		strcat(result, decode.loop_tail.c_str());
+	}
+
+	return result;
+}
+
+char *transcription_clean_text(const char *raw) {
+	if (!raw) {
+		return NULL;
+	}
+
+	// Allocate buffer with extra space for the trailing space
+	char *result = (char *) malloc(strlen(raw) + 2);// +1 for null terminator, +1 for trailing space
+	if (!result) {
+		log_error("ERROR: Failed to allocate memory for transcription\n");
+		return NULL;
+	}
+	strcpy(result, raw);
 
 	// Trim whitespace before filtering
 	char *start = result;
@@ -255,7 +1381,9 @@ char *transcription_process(const float *audio_data, int n_samples, int sample_r
 	}
 
 	// Null terminate after trimming
-	*(end + 1) = '\0';
+	if (*start) {
+		*(end + 1) = '\0';
+	}
 
 	// Move trimmed string to beginning if needed
 	if (start != result) {
@@ -270,8 +1398,6 @@ char *transcription_process(const float *audio_data, int n_samples, int sample_r
 			// Clear the result - this is a non-speech token or annotation
 			result[0] = '\0';
 			log_info("✅ Filtered out non-speech token\n");
-			log_debug("Releasing transcription mutex (filtered token) - thread=%p", utils_thread_id());
-			utils_mutex_unlock(ctx_mutex);
 			return result;
 		}
 	}
@@ -300,164 +1426,449 @@ char *transcription_process(const float *audio_data, int n_samples, int sample_r
 		strcat(result, " ");
 	}
 
-	double total_duration = utils_now() - total_start;
-
-	log_info("✅ Transcription complete: \"%s\"\n", result);
-	log_info("⏱️  Total transcription process took: %.0f ms\n", total_duration * 1000.0);
-	
-	log_debug("Releasing transcription mutex (normal completion) - thread=%p", utils_thread_id());
-	utils_mutex_unlock(ctx_mutex);
 	return result;
 }
 
 
-int transcribe_file(const char *audio_file, char *result, size_t result_size) {
-	if (ctx == NULL) {
-		log_error("ERROR: Whisper not initialized\n");
-		return -1;
+static void free_segment(TranscriptionSegment &segment) {
+	free(segment.text);
+	for (int i = 0; i < segment.n_tokens; i++) {
+		free(segment.tokens[i].text);
 	}
+	free(segment.tokens);
+}
 
-	log_info("🎵 Loading audio file: %s\n", audio_file);
+// Copy a decode's segments out of its state. offset_ms places the decoded audio
+// in the speech timeline, which spans (NULL without VAD) maps back to the input.
+static void append_segments(const Decode &decode, int offset_ms, const std::vector<SpeechSpan> *spans,
+							bool with_tokens, std::vector<TranscriptionSegment> &segments) {
+	if (decode.no_speech) {
+		return;
+	}
 
-	// Proper WAV parser
-	std::vector<float> pcmf32;
+	// whisper timestamps are in units of 10 ms
+	auto to_source_ms = [&](int64_t t) {
+		int ms = offset_ms + (int) t * 10;
+		return spans ? speech_to_source_ms(*spans, ms) : ms;
+	};
 
-	std::ifstream file(audio_file, std::ios::binary);
-	if (!file.is_open()) {
-		log_error("ERROR: Could not open audio file: %s\n", audio_file);
-		return -1;
+	const whisper_token eot = whisper_token_eot(decode.engine->ctx);
+	const int n_segments = whisper_full_n_segments_from_state(decode.state);
+	for (int i = 0; i < n_segments; ++i) {
+		const char *text = whisper_full_get_segment_text_from_state(decode.state, i);
+		TranscriptionSegment segment = {};
+		segment.text = utils_strdup(text ? text : "");
+		segment.t0_ms = to_source_ms(whisper_full_get_segment_t0_from_state(decode.state, i));
+		segment.t1_ms = to_source_ms(whisper_full_get_segment_t1_from_state(decode.state, i));
+		segment.no_speech_prob = whisper_full_get_segment_no_speech_prob_from_state(decode.state, i);
+
+		const int n_tokens = with_tokens ? whisper_full_n_tokens_from_state(decode.state, i) : 0;
+		if (n_tokens > 0) {
+			segment.tokens = (TranscriptionToken *) calloc(n_tokens, sizeof(TranscriptionToken));
+		}
+		for (int j = 0; segment.tokens && j < n_tokens; ++j) {
+			whisper_token_data data = whisper_full_get_token_data_from_state(decode.state, i, j);
+			if (data.id >= eot) {
+				continue;// Timestamp and other special tokens
+			}
+			const char *token_text = whisper_full_get_token_text_from_state(decode.engine->ctx, decode.state, i, j);
+			TranscriptionToken *token = &segment.tokens[segment.n_tokens++];
+			token->text = utils_strdup(token_text ? token_text : "");
+			token->t0_ms = to_source_ms(data.t0);
+			token->t1_ms = to_source_ms(data.t1);
+			token->p = data.p;
+		}
+		segments.push_back(segment);
 	}
 
-	// Read RIFF header
-	char riff[4];
-	uint32_t file_size;
-	char wave[4];
-	file.read(riff, 4);
-	file.read(reinterpret_cast<char *>(&file_size), 4);
-	file.read(wave, 4);
+	if (!decode.loop_tail.empty()) {
+		// Runs from the end of the last finished segment to the end of the audio
+		TranscriptionSegment segment = {};
+		segment.text = utils_strdup(decode.loop_tail.c_str());
+		const int64_t t0 = n_segments > 0 ? whisper_full_get_segment_t1_from_state(decode.state, n_segments - 1) : 0;
+		segment.t0_ms = to_source_ms(t0);
+		segment.t1_ms = to_source_ms(decode.decoded_ms / 10);
+		segments.push_back(segment);
+	}
+}
 
-	if (strncmp(riff, "RIFF", 4) != 0 || strncmp(wave, "WAVE", 4) != 0) {
-		log_error("ERROR: Not a valid WAV file\n");
-		file.close();
-		return -1;
+// ---------------------------------------------------------------------------
+// Long-form transcription
+
+typedef struct {
+	int start;
+	int length;
+} AudioChunk;
+
+// Split [start, end) into pieces of at most CHUNK_MAX_SAMPLES, cutting at the
+// quietest frame in the last third of each piece
+static void split_at_quiet(const float *audio, int start, int end, std::vector<AudioChunk> &chunks) {
+	while (end - start > CHUNK_MAX_SAMPLES) {
+		int cut = start + CHUNK_MAX_SAMPLES;
+		float quietest = -1.0f;
+		for (int pos = start + CHUNK_MIN_SAMPLES; pos + QUIET_FRAME_SAMPLES <= start + CHUNK_MAX_SAMPLES;
+			 pos += QUIET_FRAME_SAMPLES / 2) {
+			float energy = 0.0f;
+			for (int i = pos; i < pos + QUIET_FRAME_SAMPLES; i++) {
+				energy += audio[i] * audio[i];
+			}
+			if (quietest < 0.0f || energy < quietest) {
+				quietest = energy;
+				cut = pos + QUIET_FRAME_SAMPLES / 2;
+			}
+		}
+		AudioChunk chunk = {start, cut - start};
+		chunks.push_back(chunk);
+		start = cut;
+	}
+	if (end > start) {
+		AudioChunk chunk = {start, end - start};
+		chunks.push_back(chunk);
+	}
+}
+
+// Group speech spans (already gathered back to back) into window-sized
+// pieces, so every cut falls in a pause
+static void plan_chunks(const float *audio, int n_samples, const std::vector<SpeechSpan> &spans, bool vad_applied,
+						std::vector<AudioChunk> &chunks) {
+	if (!vad_applied) {
+		split_at_quiet(audio, 0, n_samples, chunks);
+		return;
 	}
 
-	// Find fmt chunk
-	uint16_t format_tag = 0;
-	uint16_t channels = 0;
-	uint32_t sample_rate = 0;
-	uint16_t bits_per_sample = 0;
-	uint32_t data_size = 0;
-	bool fmt_found = false;
-	bool data_found = false;
+	size_t i = 0;
+	while (i < spans.size()) {
+		int start = spans[i].dst_start;
+		int end = start + spans[i].length;
+		size_t j = i + 1;
+		while (j < spans.size() && spans[j].dst_start + spans[j].length - start <= CHUNK_MAX_SAMPLES) {
+			end = spans[j].dst_start + spans[j].length;
+			j++;
+		}
+		split_at_quiet(audio, start, end, chunks);// Only splits a single over-long span
+		i = j;
+	}
+}
 
-	while (!fmt_found || !data_found) {
-		char chunk_id[4];
-		uint32_t chunk_size;
+// Transcribe long audio as independent pieces on all decoder states at once
+// and stitch the segments back together in order. Returns false when the
+// audio is too short or the engine has a single state, so the caller should
+// decode it in one go; otherwise segments holds the result (empty if there
+// was no speech) and ok tells whether every piece decoded.
+static bool process_long_form(TranscriptionEngine *engine, const float *audio_data, int n_samples, bool run_vad,
+							  const char *initial_prompt, int flags, const Job &job,
+							  std::vector<TranscriptionSegment> &segments, bool &ok) {
+	ensure_mutex_initialized();
+	if (audio_data == NULL || n_samples < LONG_FORM_MIN_SAMPLES ||
+		!preferences_get_bool("parallel_long_form", true)) {
+		return false;
+	}
 
-		if (!file.read(chunk_id, 4) || !file.read(reinterpret_cast<char *>(&chunk_size), 4)) {
-			log_error("ERROR: Unexpected end of WAV file\n");
-			file.close();
-			return -1;
+	// Keeps transcription_cleanup() waiting until the pieces are done
+	DecodeSetup setup;
+	if (!begin_decode(engine, flags, setup)) {
+		return false;
+	}
+	engine = setup.engine;
+	if (engine->states.size() < 2) {
+		static std::atomic<bool> logged(false);
+		if (!logged.exchange(true)) {
+			log_info("🧩 Long-form decoding needs transcription_states of 2 or more; decoding in one go");
 		}
+		release_engine(engine);
+		return false;
+	}
+
+	std::vector<float> speech;
+	std::vector<SpeechSpan> spans;
+	bool vad_applied = run_vad && extract_speech(audio_data, n_samples, speech, spans);
+	if ((vad_applied && spans.empty()) ||
+		(!vad_applied && run_vad && preferences_get_bool("speech_gate", true) &&
+		 !has_voiced_audio(audio_data, n_samples))) {
+		release_engine(engine);
+		count_skipped_clip(n_samples);
+		ok = true;
+		return true;
+	}
+
+	const float *audio = vad_applied ? speech.data() : audio_data;
+	const int n_audio = vad_applied ? (int) speech.size() : n_samples;
+	std::vector<AudioChunk> chunks;
+	plan_chunks(audio, n_audio, spans, vad_applied, chunks);
 
-		if (strncmp(chunk_id, "fmt ", 4) == 0) {
-			file.read(reinterpret_cast<char *>(&format_tag), 2);
-			file.read(reinterpret_cast<char *>(&channels), 2);
-			file.read(reinterpret_cast<char *>(&sample_rate), 4);
-			file.seekg(6, std::ios::cur);// skip byte_rate and block_align
-			file.read(reinterpret_cast<char *>(&bits_per_sample), 2);
-			file.seekg(chunk_size - 16, std::ios::cur);// skip any extra fmt data
-			fmt_found = true;
-		} else if (strncmp(chunk_id, "data", 4) == 0) {
-			data_size = chunk_size;
-			data_found = true;
-
-			// If data_size is 0, calculate actual size from file
-			if (data_size == 0) {
-				std::streampos current_pos = file.tellg();
-				file.seekg(0, std::ios::end);
-				std::streampos end_pos = file.tellg();
-				data_size = (uint32_t) (end_pos - current_pos);
-				file.seekg(current_pos);// return to data start
-				log_info("🎵 Data chunk size was 0, calculated actual size: %u bytes\n", data_size);
+	const int n_workers = std::min((int) engine->states.size(), (int) chunks.size());
+	log_info("🧩 Long-form: %.1f s in %d pieces on %d decoder states", (float) n_samples / SAMPLE_RATE,
+			 (int) chunks.size(), n_workers);
+	Job pieces_job = job;
+	pieces_job.parallel = n_workers;
+
+	double start = utils_now();
+	std::vector<std::vector<TranscriptionSegment>> pieces(chunks.size());
+	std::vector<bool> piece_ok(chunks.size(), false);
+	std::atomic<int> next(0);
+	auto worker = [&]() {
+		for (int c = next++; c < (int) chunks.size(); c = next++) {
+			if (job_stopped(pieces_job)) {
+				piece_ok[c] = true;// Skipped, not failed
+				continue;
 			}
+			// The job's own reference keeps the engine alive; ctx_mutex is never needed
+			Decode decode;
+			const char *prompt = c == 0 ? initial_prompt : NULL;
+			retain_engine(engine);
+			if (!decode_with_setup(setup, audio + chunks[c].start, chunks[c].length, false, prompt, flags, NULL,
+								   pieces_job, decode)) {
+				continue;
+			}
+			append_segments(decode, chunks[c].start / (SAMPLE_RATE / 1000), vad_applied ? &spans : NULL,
+							(flags & DECODE_TOKENS) != 0, pieces[c]);
+			finish_decode(decode);
+			piece_ok[c] = true;
+		}
+	};
 
-			break;// data chunk found, ready to read audio
-		} else {
-			// Skip unknown chunk
-			file.seekg(chunk_size, std::ios::cur);
+	std::vector<std::thread> threads;
+	for (int i = 1; i < n_workers; i++) {
+		threads.push_back(std::thread(worker));
+	}
+	worker();
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i].join();
+	}
+
+	ok = true;
+	for (size_t c = 0; c < chunks.size(); c++) {
+		ok = ok && piece_ok[c];
+		segments.insert(segments.end(), pieces[c].begin(), pieces[c].end());
+	}
+	log_info("🧩 Long-form pieces done in %.0f ms%s", (utils_now() - start) * 1000.0,
+			 ok ? "" : " (some pieces failed)");
+
+	release_engine(engine);
+	return true;
+}
+
+static char *process_audio(TranscriptionEngine *engine, const float *audio_data, int n_samples, bool run_vad,
+						   const MelSpectrogram *mel, int flags) {
+	log_debug("transcription_process() ENTRY - thread=%p", utils_thread_id());
+
+	log_info("🧠 Transcribing %d audio samples (%.2f seconds)\n", n_samples, (float) n_samples / SAMPLE_RATE);
+
+	double total_start = utils_now();
+	const Job job = begin_job();
+
+	std::vector<TranscriptionSegment> long_form;
+	bool long_form_ok = false;
+	if (!(flags & DECODE_DRAFT) &&
+		process_long_form(engine, audio_data, n_samples, run_vad, NULL, 0, job, long_form, long_form_ok)) {
+		std::string raw;
+		for (size_t i = 0; i < long_form.size(); i++) {
+			raw += (i > 0 ? " " : "") + std::string(long_form[i].text ? long_form[i].text : "");
+			free_segment(long_form[i]);
+		}
+		if (!long_form_ok) {
+			return NULL;
+		}
+		if (long_form.empty()) {
+			log_info("⚠️  No speech detected\n");
+			return utils_strdup("");
 		}
+		char *result = transcription_clean_text(raw.c_str());
+		if (result) {
+			log_info("✅ Transcription complete: \"%s\"\n", result);
+			log_info("⏱️  Total transcription process took: %.0f ms\n", (utils_now() - total_start) * 1000.0);
+		}
+		return result;
 	}
 
-	if (!fmt_found || !data_found) {
-		log_error("ERROR: Missing fmt or data chunk in WAV file\n");
-		file.close();
-		return -1;
+	Decode decode;
+	if (!run_decode(engine, audio_data, n_samples, run_vad, NULL, DECODE_TEXT_ONLY | flags, mel, job, decode)) {
+		return NULL;
+	}
+
+	// Get transcription result
+	if (decode.no_speech || (whisper_full_n_segments_from_state(decode.state) == 0 && decode.loop_tail.empty())) {
+		log_info("⚠️  No speech detected\n");
+		finish_decode(decode);
+		return utils_strdup("");
 	}
 
-	log_info("🎵 WAV: %s, %dHz, %d channels, %d bits, format %d\n",
-			 audio_file, sample_rate, channels, bits_per_sample, format_tag);
+	char *raw = collect_segment_text(decode);
+	finish_decode(decode);
 
-	// Read audio data based on format
-	uint32_t num_samples = data_size / (bits_per_sample / 8) / channels;
-	pcmf32.reserve(num_samples);
+	char *result = transcription_clean_text(raw);
+	free(raw);
+	if (!result) {
+		return NULL;
+	}
 
-	if (format_tag == 3 && bits_per_sample == 32) {
-		// 32-bit float PCM
-		for (uint32_t i = 0; i < num_samples; i++) {
-			float sample_sum = 0.0f;
+	double total_duration = utils_now() - total_start;
 
-			// Read all channels and average them for mono output
-			for (uint16_t ch = 0; ch < channels; ch++) {
-				float sample;
-				if (!file.read(reinterpret_cast<char *>(&sample), 4)) {
-					break;
-				}
-				sample_sum += sample;
-			}
+	log_info("✅ Transcription complete: \"%s\"\n", result);
+	log_info("⏱️  Total transcription process took: %.0f ms\n", total_duration * 1000.0);
 
-			if (file.fail()) break;
-			pcmf32.push_back(sample_sum / channels);// Average channels for mono
-		}
-	} else if (format_tag == 1 && bits_per_sample == 16) {
-		// 16-bit integer PCM
-		for (uint32_t i = 0; i < num_samples; i++) {
-			float sample_sum = 0.0f;
+	return result;
+}
 
-			// Read all channels and average them for mono output
-			for (uint16_t ch = 0; ch < channels; ch++) {
-				int16_t sample;
-				if (!file.read(reinterpret_cast<char *>(&sample), 2)) {
-					break;
-				}
-				sample_sum += static_cast<float>(sample) / 32768.0f;
-			}
+char *transcription_process(const float *audio_data, int n_samples, int sample_rate) {
+	(void) sample_rate;// Currently unused
+	return process_audio(NULL, audio_data, n_samples, true, NULL, 0);
+}
+
+char *transcription_process_speech(const float *audio_data, int n_samples) {
+	return process_audio(NULL, audio_data, n_samples, false, NULL, 0);
+}
+
+float *transcription_extract_speech(const float *audio_data, int n_samples, int *n_speech) {
+	std::vector<float> speech;
+	std::vector<SpeechSpan> spans;
+	if (!audio_data || n_samples <= 0 || !extract_speech(audio_data, n_samples, speech, spans)) {
+		return NULL;
+	}
+	if (spans.empty()) {
+		count_skipped_clip(n_samples);
+	}
+
+	float *result = (float *) malloc(std::max<size_t>(speech.size(), 1) * sizeof(float));
+	if (!result) {
+		log_error("ERROR: Failed to allocate memory for speech audio");
+		return NULL;
+	}
+	if (!speech.empty()) {
+		memcpy(result, speech.data(), speech.size() * sizeof(float));
+	}
+	*n_speech = (int) speech.size();
+	return result;
+}
 
-			if (file.fail()) break;
-			pcmf32.push_back(sample_sum / channels);// Average channels for mono
+char *transcription_process_mel(const float *audio_data, int n_samples, const MelSpectrogram *mel) {
+	return process_audio(NULL, audio_data, n_samples, true, mel, 0);
+}
+
+char *transcription_process_draft(const float *audio_data, int n_samples, bool speech_only) {
+	return process_audio(NULL, audio_data, n_samples, !speech_only, NULL, DECODE_DRAFT);
+}
+
+char *transcription_engine_process(TranscriptionEngine *engine, const float *audio_data, int n_samples) {
+	if (!engine) {
+		return NULL;
+	}
+	return process_audio(engine, audio_data, n_samples, true, NULL, 0);
+}
+
+static TranscriptionResult *process_segments(TranscriptionEngine *engine, const float *audio_data, int n_samples,
+											 const char *initial_prompt, int flags, bool *abort) {
+	Job job = begin_job();
+	job.abort = abort;
+	std::vector<TranscriptionSegment> segments;
+	bool ok = false;
+	if (!process_long_form(engine, audio_data, n_samples, true, initial_prompt, flags, job, segments, ok)) {
+		Decode decode;
+		ok = run_decode(engine, audio_data, n_samples, true, initial_prompt, flags, NULL, job, decode);
+		if (ok) {
+			append_segments(decode, 0, decode.vad_applied ? &decode.spans : NULL, (flags & DECODE_TOKENS) != 0,
+							segments);
+			finish_decode(decode);
 		}
-	} else {
-		log_error("ERROR: Unsupported WAV format (format=%d, bits=%d)\n", format_tag, bits_per_sample);
-		file.close();
-		return -1;
 	}
 
-	file.close();
+	TranscriptionResult *result = ok ? (TranscriptionResult *) calloc(1, sizeof(TranscriptionResult)) : NULL;
+	if (result && !segments.empty()) {
+		result->segments = (TranscriptionSegment *) malloc(segments.size() * sizeof(TranscriptionSegment));
+		if (!result->segments) {
+			free(result);
+			result = NULL;
+		}
+	}
+	if (!result) {
+		for (size_t i = 0; i < segments.size(); i++) {
+			free_segment(segments[i]);
+		}
+		return NULL;
+	}
+
+	memcpy(result->segments, segments.data(), segments.size() * sizeof(TranscriptionSegment));
+	result->n_segments = (int) segments.size();
+	return result;
+}
+
+TranscriptionResult *transcription_process_segments(const float *audio_data, int n_samples,
+													const char *initial_prompt, bool split_words) {
+	return process_segments(NULL, audio_data, n_samples, initial_prompt, split_words ? DECODE_SPLIT_WORDS : 0, NULL);
+}
+
+TranscriptionResult *transcription_process_segments_abortable(const float *audio_data, int n_samples,
+															  const char *initial_prompt, bool split_words,
+															  bool *abort) {
+	return process_segments(NULL, audio_data, n_samples, initial_prompt, split_words ? DECODE_SPLIT_WORDS : 0,
+							abort);
+}
+
+TranscriptionResult *transcription_engine_process_segments(TranscriptionEngine *engine, const float *audio_data,
+														   int n_samples, const char *initial_prompt,
+														   bool split_words) {
+	if (!engine) {
+		return NULL;
+	}
+	return process_segments(engine, audio_data, n_samples, initial_prompt, split_words ? DECODE_SPLIT_WORDS : 0,
+							NULL);
+}
+
+TranscriptionResult *transcription_process_detailed(const float *audio_data, int n_samples) {
+	return process_segments(NULL, audio_data, n_samples, NULL, DECODE_TOKENS, NULL);
+}
+
+TranscriptionResult *transcription_engine_process_detailed(TranscriptionEngine *engine, const float *audio_data,
+															int n_samples) {
+	if (!engine) {
+		return NULL;
+	}
+	return process_segments(engine, audio_data, n_samples, NULL, DECODE_TOKENS, NULL);
+}
+
+void transcription_get_stats(TranscriptionStats *stats) {
+	stats->loops_stopped = g_loops_stopped.load();
+	stats->clips_skipped = g_clips_skipped.load();
+	stats->skipped_audio_s = g_skipped_audio_ms.load() / 1000.0;
+}
+
+void transcription_cancel(void) {
+	g_cancel_generation++;
+}
+
+void transcription_result_free(TranscriptionResult *result) {
+	if (!result) {
+		return;
+	}
+
+	for (int i = 0; i < result->n_segments; ++i) {
+		free_segment(result->segments[i]);
+	}
+	free(result->segments);
+	free(result);
+}
+
 
-	if (pcmf32.empty()) {
-		log_error("ERROR: No audio data found in file: %s\n", audio_file);
+int transcribe_file(const char *audio_file, char *result, size_t result_size) {
+	if (transcription_get_engine() == NULL) {
+		log_error("ERROR: Whisper not initialized\n");
 		return -1;
 	}
 
-	log_info("🎵 Loaded %zu audio samples\n", pcmf32.size());
+	log_info("🎵 Loading audio file: %s\n", audio_file);
+
+	// Any supported format, converted to 16 kHz mono
+	int n_samples = 0;
+	float *audio_data = audio_input_read_file(audio_file, &n_samples);
+	if (!audio_data) {
+		return -1;
+	}
 
-	// Convert to C-style array access for transcription
-	const float *audio_data = pcmf32.data();
-	int n_samples = (int) pcmf32.size();
+	log_info("🎵 Loaded %d audio samples\n", n_samples);
 
 	// Get dynamic transcription
-	char *transcription = transcription_process(audio_data, n_samples, sample_rate);
+	char *transcription = transcription_process(audio_data, n_samples, SAMPLE_RATE);
+	free(audio_data);
 	if (transcription == NULL) {
 		return -1;
 	}
@@ -476,20 +1887,235 @@ int transcribe_file(const char *audio_file, char *result, size_t result_size) {
 }
 
 
+// Synthetic clips for warm-up and tuning: quiet noise, long enough to exercise
+// the encoder bucket typical dictations use
+#define WARMUP_SAMPLES (SAMPLE_RATE * 3)
+#define TUNE_SAMPLES (SAMPLE_RATE * 5)
+// Timed runs per candidate thread count; the fastest one counts
+#define TUNE_RUNS 2
+// Prefer fewer threads unless more are at least this much faster
+#define TUNE_TOLERANCE 0.05
+
+static bool background_abort_callback(void *user_data) {
+	TranscriptionEngine *engine = (TranscriptionEngine *) user_data;
+	return engine->stopping || engine->waiters > 0;
+}
+
+static std::vector<float> synthetic_clip(int n_samples) {
+	std::vector<float> clip(n_samples);
+	unsigned int seed = 12345;
+	for (size_t i = 0; i < clip.size(); i++) {
+		seed = seed * 1103515245u + 12345u;
+		clip[i] = ((float) ((seed >> 16) & 0x7fff) / 32767.0f - 0.5f) * 0.02f;
+	}
+	return clip;
+}
+
+// One timed inference on the clip; returns its duration in seconds, or a
+// negative value if it failed. A background pass only takes a free state and
+// gives way to any real transcription.
+static double timed_pass(TranscriptionEngine *engine, const std::vector<float> &clip, int n_threads,
+						 bool background) {
+	{
+		std::lock_guard<std::mutex> lock(engine->pool_mutex);
+		engine->pending++;
+	}
+
+	// Never queue behind (or in front of) a real transcription
+	int index = acquire_state(engine, !background);
+	if (index < 0) {
+		release_engine(engine);
+		return -1.0;
+	}
+
+	struct whisper_full_params wparams = make_full_params(engine, "en", load_profile(active_profile()));
+	wparams.n_threads = n_threads;
+	wparams.audio_ctx = choose_audio_ctx(engine, (int) clip.size());
+	wparams.no_context = true;
+	if (background) {
+		wparams.abort_callback = background_abort_callback;
+		wparams.abort_callback_user_data = engine;
+	}
+
+	double start = utils_now();
+	int result = whisper_full_with_state(engine->ctx, engine->states[index], wparams, clip.data(), (int) clip.size());
+	double duration = utils_now() - start;
+
+	release_state(engine, index);
+	bool aborted = background && background_abort_callback(engine);
+	return result == 0 && !aborted ? duration : -1.0;
+}
+
+// Benchmark candidate thread counts on a synthetic clip, persist the fastest
+// for this model and CPU and apply it. Returns the chosen count, or -1 if
+// interrupted. whisper_full takes a single thread count for encoder and
+// decoder, so one value is tuned.
+static int tune_threads(TranscriptionEngine *engine, bool background) {
+	utils_cpu_info_t cpu;
+	utils_get_cpu_info(&cpu);
+
+	std::vector<int> candidates;
+	candidates.push_back(cpu.performance_cores);
+	candidates.push_back(cpu.physical_cores);
+	candidates.push_back(cpu.physical_cores - 1);
+	candidates.push_back(cpu.logical_cpus);
+	for (int n = 2; n < cpu.logical_cpus; n *= 2) {
+		candidates.push_back(n);
+	}
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+	candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+									[&](int n) { return n < 1 || n > cpu.logical_cpus; }),
+					 candidates.end());
+
+	log_info("🧪 Tuning inference threads for %s on %s (%d logical, %d physical, %d performance cores)",
+			 engine->model_name, cpu.name, cpu.logical_cpus, cpu.physical_cores, cpu.performance_cores);
+
+	std::vector<float> clip = synthetic_clip(TUNE_SAMPLES);
+	std::vector<double> times;
+	double fastest = 0.0;
+	for (size_t i = 0; i < candidates.size(); i++) {
+		double best = -1.0;
+		for (int run = 0; run < TUNE_RUNS; run++) {
+			double duration = timed_pass(engine, clip, candidates[i], background);
+			if (duration < 0.0) {
+				log_info("🧪 Thread tuning interrupted");
+				return -1;
+			}
+			if (best < 0.0 || duration < best) {
+				best = duration;
+			}
+		}
+		times.push_back(best);
+		if (i == 0 || best < fastest) {
+			fastest = best;
+		}
+		log_info("🧪 %2d threads: %.0f ms", candidates[i], best * 1000.0);
+	}
+
+	int chosen = candidates.back();
+	for (size_t i = 0; i < candidates.size(); i++) {
+		if (times[i] <= fastest * (1.0 + TUNE_TOLERANCE)) {
+			chosen = candidates[i];
+			break;
+		}
+	}
+
+	char key[64];
+	tuning_key(engine, key, sizeof(key));
+	preferences_set_int(key, chosen);
+	preferences_save();
+	transcription_engine_set_threads(engine, chosen);
+
+	log_info("🧪 Using %d inference threads (saved as %s)", chosen, key);
+	return chosen;
+}
+
+static void warmup_main(TranscriptionEngine *engine) {
+	std::vector<float> clip = synthetic_clip(WARMUP_SAMPLES);
+	const int n_threads = engine->n_threads.load();
+
+	// First run pays for buffer page faults, backend kernels and weight caches;
+	// the second shows what a warm dictation costs
+	double cold = timed_pass(engine, clip, n_threads, true);
+	double warm = cold >= 0.0 ? timed_pass(engine, clip, n_threads, true) : -1.0;
+
+	if (cold < 0.0 || warm < 0.0) {
+		log_info("🔥 Model warm-up interrupted by a transcription");
+		return;
+	}
+	log_info("🔥 Model warm-up done: cold inference %.0f ms, warm inference %.0f ms", cold * 1000.0, warm * 1000.0);
+
+	// Tune once per model and CPU; an interrupted run is retried on the next load
+	char key[64];
+	tuning_key(engine, key, sizeof(key));
+	if (preferences_get_int(key, 0) <= 0 && preferences_get_bool("autotune_threads", true)) {
+		tune_threads(engine, true);
+	}
+}
+
+void transcription_warmup(void) {
+	ensure_mutex_initialized();
+	utils_mutex_lock(ctx_mutex);
+
+	if (g_engine && !g_engine->warmup_thread.joinable()) {
+		g_engine->warmup_thread = std::thread(warmup_main, g_engine);
+	}
+	if (g_draft_engine && !g_draft_engine->warmup_thread.joinable()) {
+		g_draft_engine->warmup_thread = std::thread(warmup_main, g_draft_engine);
+	}
+
+	utils_mutex_unlock(ctx_mutex);
+}
+
+int transcription_tune_threads(void) {
+	TranscriptionEngine *engine = transcription_get_engine();
+	if (!engine) {
+		log_error("ERROR: Whisper not initialized");
+		return -1;
+	}
+	return tune_threads(engine, false);
+}
+
+int transcription_init_draft(const char *model_path) {
+	ensure_mutex_initialized();
+
+	// Detach the old draft model first; it is freed without ctx_mutex once its
+	// transcriptions are done, since those may still need the lock
+	utils_mutex_lock(ctx_mutex);
+	TranscriptionEngine *old_engine = g_draft_engine;
+	g_draft_engine = NULL;
+	utils_mutex_unlock(ctx_mutex);
+	transcription_engine_free(old_engine);
+
+	// Drafts are one at a time on the transcription worker
+	TranscriptionEngine *engine = transcription_engine_create(model_path, 1);
+	if (!engine) {
+		return -1;
+	}
+
+	utils_mutex_lock(ctx_mutex);
+	old_engine = g_draft_engine;
+	g_draft_engine = engine;
+	utils_mutex_unlock(ctx_mutex);
+	transcription_engine_free(old_engine);// Loaded concurrently; keep the newest
+
+	log_info("✏️  Draft model loaded: %s", engine->model_name);
+	return 0;
+}
+
+bool transcription_has_draft(void) {
+	ensure_mutex_initialized();
+	utils_mutex_lock(ctx_mutex);
+	bool loaded = g_draft_engine != NULL;
+	utils_mutex_unlock(ctx_mutex);
+	return loaded;
+}
+
 void transcription_cleanup(void) {
 	ensure_mutex_initialized();
-	
+
 	utils_mutex_lock(ctx_mutex);
-	
-	if (ctx != NULL) {
-		// Cleanup whisper context
-		struct whisper_context *old_ctx = ctx;
-		ctx = NULL;  // Set to NULL first to prevent double cleanup
-		
-		if (old_ctx != NULL) {
-			whisper_free(old_ctx);
-		}
+
+	if (g_clips_skipped > 0 || g_loops_stopped > 0) {
+		log_info("📊 Skipped whisper for %d clips without speech (%.1f s of audio), stopped %d repetition loops",
+				 g_clips_skipped.load(), g_skipped_audio_ms.load() / 1000.0, g_loops_stopped.load());
 	}
-	
+
+	// Set to NULL first to prevent double cleanup. The engines are freed once
+	// running transcriptions finish, without ctx_mutex since those may need it.
+	TranscriptionEngine *old_engine = g_engine;
+	TranscriptionEngine *old_draft = g_draft_engine;
+	g_engine = NULL;
+	g_draft_engine = NULL;
 	utils_mutex_unlock(ctx_mutex);
+
+	transcription_engine_free(old_engine);
+	transcription_engine_free(old_draft);
+
+	std::lock_guard<std::mutex> lock(vad_mutex);
+	if (vad_ctx != NULL) {
+		whisper_vad_free(vad_ctx);
+		vad_ctx = NULL;
+	}
 }
@@ -1,19 +1,160 @@
 #ifndef TRANSCRIPTION_H
 #define TRANSCRIPTION_H
 
+#include <stdbool.h>
+
+struct MelSpectrogram;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// A decoded token; p is the decoder's probability for it
+typedef struct {
+    char *text;
+    int t0_ms;
+    int t1_ms;
+    float p;
+} TranscriptionToken;
+
+// A transcribed span of audio; times are relative to the start of the input
+typedef struct {
+    char *text;
+    int t0_ms;
+    int t1_ms;
+    float no_speech_prob;
+    TranscriptionToken *tokens;// Only filled by the *_process_detailed() functions
+    int n_tokens;
+} TranscriptionSegment;
+
+typedef struct {
+    TranscriptionSegment *segments;
+    int n_segments;
+} TranscriptionResult;
+
+// Handle-based engine - one loaded model serving a pool of decoder states that
+// share its weights, so up to n_states clips can be transcribed concurrently.
+typedef struct TranscriptionEngine TranscriptionEngine;
+
+// Returns NULL on failure
+TranscriptionEngine *transcription_engine_create(const char *model_path, int n_states);
+// Waits for running transcriptions on the engine, then frees it
+void transcription_engine_free(TranscriptionEngine *engine);
+int transcription_engine_n_states(const TranscriptionEngine *engine);
+// Mel bands the engine's model expects (80, or 128 for large-v3)
+int transcription_engine_n_mels(const TranscriptionEngine *engine);
+// Inference thread budget of the engine; decodes running at the same time split it
+int transcription_engine_get_threads(const TranscriptionEngine *engine);
+void transcription_engine_set_threads(TranscriptionEngine *engine, int n_threads);
+// Same as transcription_process() / transcription_process_segments() on a given engine
+char *transcription_engine_process(TranscriptionEngine *engine, const float *audio_data, int n_samples);
+TranscriptionResult *transcription_engine_process_segments(TranscriptionEngine *engine, const float *audio_data,
+                                                           int n_samples, const char *initial_prompt,
+                                                           bool split_words);
+TranscriptionResult *transcription_engine_process_detailed(TranscriptionEngine *engine, const float *audio_data,
+                                                            int n_samples);
+
+// The default engine behind the functions below, NULL before transcription_init()
+TranscriptionEngine *transcription_get_engine(void);
+
+// Load the default engine; its pool size comes from the transcription_states
+// preference (default 2, so long recordings decode in parallel pieces). Every
+// state holds its own KV caches and compute buffers: tens of MB for the small
+// models, a few hundred for large ones.
 int transcription_init(const char *model_path);
+// Run a short synthetic inference on a background thread (one per model, with
+// a draft model loaded) so the first real dictation doesn't pay the cold-start
+// cost. A transcription that needs the decoder state interrupts it.
+void transcription_warmup(void);
+// Benchmark inference thread counts for the loaded model on this CPU, store
+// the fastest in preferences (applied automatically on later loads) and use it.
+// Returns the chosen thread count, or -1 on failure.
+int transcription_tune_threads(void);
 void transcription_cleanup(void);
 void transcription_set_language(const char *language);
+// Limit language "auto" to these comma-separated codes ("en,de,fr"); NULL or
+// empty allows every language the model knows. When unsure between the top
+// two, transcription_process() decodes both and keeps the more confident text.
+void transcription_set_auto_languages(const char *codes);
+// Two-pass dictation: a small draft model resident next to the main one gives
+// a quick first transcript that the main model's text later replaces.
+// Load the draft model; transcription_cleanup() frees it with the main one.
+// Returns 0 on success, -1 on failure.
+int transcription_init_draft(const char *model_path);
+bool transcription_has_draft(void);
+// Transcribe with the draft model, cleaned like transcription_process(); with
+// speech_only the audio is already reduced to speech as for
+// transcription_process_speech(). Returns NULL if no draft model is loaded.
+char *transcription_process_draft(const float *audio_data, int n_samples, bool speech_only);
+// Decoding profiles trade accuracy for latency: "fast", "balanced" (the default)
+// and "accurate", indexed fastest first. Each bundles the sampling strategy,
+// beam size, temperature fallback, timestamps, segmenting, token limit and
+// encoder window; fields can be overridden in preferences as
+// profile_<name>_<field>.
+int transcription_profile_count(void);
+const char *transcription_profile_name(int index);
+// Use a profile by name for every engine; NULL follows the decode_profile preference
+// again. Returns false for an unknown name.
+bool transcription_set_profile(const char *name);
+const char *transcription_get_profile(void);
 // Process audio data and return transcribed text.
 // Returns malloc'd string that caller must free, or NULL on error.
 // The returned string is cleaned (trimmed, filtered) and includes a trailing space
 // for convenient pasting into text fields.
 char *transcription_process(const float *audio_data, int n_samples, int sample_rate);
 
+// Like transcription_process(), for audio that has already been reduced to
+// speech spans (see vad_stream_compact), so the VAD pass is skipped.
+char *transcription_process_speech(const float *audio_data, int n_samples);
+
+// Run VAD once and gather the speech spans, for clips that several passes
+// transcribe with transcription_process_speech(). Returns a malloc'd buffer of
+// *n_speech samples (0 if there is no speech), or NULL when VAD is disabled
+// or unavailable and the audio should be used as is.
+float *transcription_extract_speech(const float *audio_data, int n_samples, int *n_speech);
+
+// Like transcription_process(), with the audio's spectrogram from mel_stream_finish()
+// so whisper can skip computing it. Falls back to the samples when VAD changed
+// the audio or the spectrogram doesn't fit the model.
+char *transcription_process_mel(const float *audio_data, int n_samples, const struct MelSpectrogram *mel);
+
+// Process audio data and return the raw timestamped segments.
+// initial_prompt (may be NULL) conditions the decoder on preceding text.
+// With split_words every segment holds a single word.
+// Returns NULL on error; free with transcription_result_free().
+TranscriptionResult *transcription_process_segments(const float *audio_data, int n_samples,
+                                                    const char *initial_prompt, bool split_words);
+// Like transcription_process_segments(), stopped early like transcription_cancel()
+// does once *abort (set with utils_atomic_write_bool) becomes true; other
+// transcriptions carry on.
+TranscriptionResult *transcription_process_segments_abortable(const float *audio_data, int n_samples,
+                                                              const char *initial_prompt, bool split_words,
+                                                              bool *abort);
+// Segments with their tokens, token probabilities and timestamps, for
+// structured output (JSON, subtitles). Free with transcription_result_free().
+TranscriptionResult *transcription_process_detailed(const float *audio_data, int n_samples);
+void transcription_result_free(TranscriptionResult *result);
+
+// Counters since start-up, for diagnostics and benchmarks
+typedef struct {
+    int loops_stopped; // Decodes cut short by the repetition/length monitor
+    int clips_skipped; // Clips without speech that never reached whisper (VAD or the energy gate)
+    double skipped_audio_s;
+} TranscriptionStats;
+
+void transcription_get_stats(TranscriptionStats *stats);
+
+// Stop every transcription running or waiting for a decoder state now; each
+// returns the segments it finished so far (often none). Transcriptions started
+// afterwards are unaffected. The transcription_deadline_ms preference bounds
+// each transcription the same way.
+void transcription_cancel(void);
+
+// Apply the same cleanup transcription_process() does to raw segment text:
+// trim, drop bracketed non-speech annotations, collapse spaces, add trailing space.
+// Returns malloc'd string that caller must free.
+char *transcription_clean_text(const char *raw);
+
 #ifdef __cplusplus
 }
 #endif
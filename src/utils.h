@@ -2,6 +2,7 @@
 #define UTILS_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h> // For FILE*
 
 double utils_get_time(void);
@@ -36,6 +37,14 @@ FILE *utils_fopen_read_binary(const char *path);
 FILE *utils_fopen_write(const char *path);
 FILE *utils_fopen_write_binary(const char *path);
 FILE *utils_fopen_append(const char *path);
+// Map a whole file read-only; returns NULL on failure or for an empty file.
+// Release with utils_unmap_file().
+const void *utils_map_file(const char *path, size_t *size);
+void utils_unmap_file(const void *data, size_t size);
+// Call fn with the full path of every regular file in dir (not recursive).
+// Returns false if dir can't be read as a directory.
+typedef void (*utils_dir_fn)(const char *path, void *user_data);
+bool utils_list_dir(const char *dir, utils_dir_fn fn, void *user_data);
 char *utils_strdup(const char *str);
 int utils_stricmp(const char *s1, const char *s2);
 
@@ -53,7 +62,37 @@ void utils_mutex_destroy(utils_mutex_t* mutex);
 void utils_mutex_lock(utils_mutex_t* mutex);
 void utils_mutex_unlock(utils_mutex_t* mutex);
 
+// Condition variable for sleeping until state guarded by a utils mutex changes
+typedef struct utils_cond utils_cond_t;
+
+utils_cond_t *utils_cond_create(void);
+void utils_cond_destroy(utils_cond_t *cond);
+// Unlock the (held) mutex, sleep until signalled and lock it again; may wake spuriously
+void utils_cond_wait(utils_cond_t *cond, utils_mutex_t *mutex);
+void utils_cond_signal(utils_cond_t *cond);
+void utils_cond_broadcast(utils_cond_t *cond);
+
 // Cross-platform thread ID for debugging
 void* utils_thread_id(void);
 
+// Joinable thread API for long-lived worker threads
+typedef struct utils_thread utils_thread_t;
+typedef void *(*utils_thread_fn)(void *arg);
+
+// Returns NULL if the thread could not be created
+utils_thread_t *utils_thread_create(utils_thread_fn fn, void *arg);
+// Wait for the thread to exit and free the handle
+void utils_thread_join(utils_thread_t *thread);
+
+// CPU topology, for choosing inference thread counts
+typedef struct {
+    int logical_cpus;
+    int physical_cores;
+    int performance_cores; // Same as physical_cores unless the CPU is hybrid (P/E cores)
+    char name[128];        // CPU model name, "unknown" if not available
+} utils_cpu_info_t;
+
+// Returns false if the topology could not be read; fields then hold best guesses
+bool utils_get_cpu_info(utils_cpu_info_t *info);
+
 #endif // UTILS_H
\ No newline at end of file
@@ -0,0 +1,304 @@
+extern "C" {
+#include "vad.h"
+#include "logging.h"
+#include "preferences.h"
+#include "utils.h"
+}
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#define VAD_SAMPLE_RATE 16000
+// Silero scores one probability per 512-sample window at 16 kHz
+#define VAD_WINDOW_SAMPLES 512
+// Audio handed to the model per worker iteration (about 1 second)
+#define VAD_BLOCK_SAMPLES (VAD_WINDOW_SAMPLES * 32)
+
+typedef std::pair<int, int> SampleSpan;// [start, end) in samples
+
+struct VadTimeline {
+	std::vector<float> probs;// One probability per window from the start of the recording
+};
+
+static struct whisper_vad_context *vctx = NULL;
+static std::mutex vctx_mutex;// Silero context is not reentrant
+
+// Timeline state shared by the feeding, worker and compacting threads
+static std::mutex state_mutex;
+static std::condition_variable state_cv;
+static std::vector<float> pending;// Fed samples; those before pending_offset are scored
+static size_t pending_offset = 0;
+static std::vector<float> probs;  // One probability per window since vad_stream_begin
+static bool worker_busy = false;
+static bool worker_stop = false;
+static int generation = 0;// Bumped per recording so stale blocks are dropped
+static std::thread worker;
+
+// Score a block of audio; returns its per-window probabilities
+static std::vector<float> score_block(const float *samples, int n_samples) {
+	std::vector<float> result;
+
+	std::lock_guard<std::mutex> lock(vctx_mutex);
+	if (!vctx || !whisper_vad_detect_speech(vctx, samples, n_samples)) {
+		return result;
+	}
+
+	const int n_probs = whisper_vad_n_probs(vctx);
+	const float *block_probs = whisper_vad_probs(vctx);
+	result.assign(block_probs, block_probs + n_probs);
+	return result;
+}
+
+static void worker_main(void) {
+	std::unique_lock<std::mutex> lock(state_mutex);
+
+	while (!worker_stop) {
+		if (pending.size() - pending_offset < VAD_BLOCK_SAMPLES) {
+			state_cv.wait(lock);
+			continue;
+		}
+
+		std::vector<float> block(pending.begin() + pending_offset,
+								 pending.begin() + pending_offset + VAD_BLOCK_SAMPLES);
+		pending_offset += VAD_BLOCK_SAMPLES;
+		if (pending_offset * 2 >= pending.size()) {
+			// Drop the scored samples once they are at least half the buffer
+			pending.erase(pending.begin(), pending.begin() + pending_offset);
+			pending_offset = 0;
+		}
+		int block_generation = generation;
+		worker_busy = true;
+
+		lock.unlock();
+		std::vector<float> block_probs = score_block(block.data(), (int) block.size());
+		lock.lock();
+
+		if (block_generation == generation) {
+			// Keep the timeline aligned even if scoring failed
+			block_probs.resize(VAD_BLOCK_SAMPLES / VAD_WINDOW_SAMPLES, 1.0f);
+			probs.insert(probs.end(), block_probs.begin(), block_probs.end());
+		}
+		worker_busy = false;
+		state_cv.notify_all();
+	}
+}
+
+struct whisper_vad_params vad_current_params(void) {
+	struct whisper_vad_params params = whisper_vad_default_params();
+	params.threshold = preferences_get_int("vad_threshold_pct", (int) (params.threshold * 100.0f + 0.5f)) / 100.0f;
+	params.min_speech_duration_ms = preferences_get_int("vad_min_speech_ms", params.min_speech_duration_ms);
+	params.min_silence_duration_ms = preferences_get_int("vad_min_silence_ms", params.min_silence_duration_ms);
+	params.speech_pad_ms = preferences_get_int("vad_speech_pad_ms", params.speech_pad_ms);
+	return params;
+}
+
+// Turn window probabilities into padded, merged speech spans, using the same
+// thresholds as the VAD pass at transcription time
+static std::vector<SampleSpan> speech_spans(const std::vector<float> &window_probs, int n_samples) {
+	const struct whisper_vad_params params = vad_current_params();
+	const float neg_threshold = params.threshold - 0.15f;
+	const int min_speech = params.min_speech_duration_ms * (VAD_SAMPLE_RATE / 1000);
+	const int min_silence = params.min_silence_duration_ms * (VAD_SAMPLE_RATE / 1000);
+	const int pad = params.speech_pad_ms * (VAD_SAMPLE_RATE / 1000);
+
+	std::vector<SampleSpan> spans;
+	bool in_speech = false;
+	int speech_start = 0;
+	int silence_start = -1;
+
+	for (size_t i = 0; i < window_probs.size(); i++) {
+		const int pos = (int) i * VAD_WINDOW_SAMPLES;
+		const float p = window_probs[i];
+
+		if (p >= params.threshold) {
+			if (!in_speech) {
+				in_speech = true;
+				speech_start = pos;
+			}
+			silence_start = -1;
+		} else if (in_speech && p < neg_threshold) {
+			if (silence_start < 0) {
+				silence_start = pos;
+			} else if (pos - silence_start >= min_silence) {
+				if (silence_start - speech_start >= min_speech) {
+					spans.push_back(SampleSpan(speech_start, silence_start));
+				}
+				in_speech = false;
+				silence_start = -1;
+			}
+		}
+	}
+	if (in_speech && n_samples - speech_start >= min_speech) {
+		spans.push_back(SampleSpan(speech_start, n_samples));
+	}
+
+	// Pad and merge overlapping spans
+	std::vector<SampleSpan> merged;
+	for (size_t i = 0; i < spans.size(); i++) {
+		int start = std::max(0, spans[i].first - pad);
+		int end = std::min(n_samples, spans[i].second + pad);
+		if (!merged.empty() && start <= merged.back().second) {
+			merged.back().second = std::max(merged.back().second, end);
+		} else {
+			merged.push_back(SampleSpan(start, end));
+		}
+	}
+	return merged;
+}
+
+bool vad_stream_init(const char *model_path) {
+	if (vctx) {
+		return true;
+	}
+	if (!model_path) {
+		return false;
+	}
+
+	double start = utils_now();
+
+	struct whisper_vad_context_params vparams = whisper_vad_default_context_params();
+	vparams.n_threads = 1;// Runs alongside capture; keep it off the inference cores
+	vparams.use_gpu = false;
+
+	{
+		std::lock_guard<std::mutex> lock(vctx_mutex);
+		vctx = whisper_vad_init_from_file_with_params(model_path, vparams);
+	}
+	if (!vctx) {
+		log_error("ERROR: Failed to load VAD model for capture pipeline: %s", model_path);
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(state_mutex);
+		worker_stop = false;
+		pending.clear();
+		pending_offset = 0;
+		probs.clear();
+	}
+	worker = std::thread(worker_main);
+
+	log_info("🎙️ Capture VAD loaded (took %.0f ms)", (utils_now() - start) * 1000.0);
+	return true;
+}
+
+void vad_stream_cleanup(void) {
+	if (!vctx) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(state_mutex);
+		worker_stop = true;
+	}
+	state_cv.notify_all();
+	if (worker.joinable()) {
+		worker.join();
+	}
+
+	std::lock_guard<std::mutex> lock(vctx_mutex);
+	whisper_vad_free(vctx);
+	vctx = NULL;
+}
+
+bool vad_stream_is_ready(void) {
+	return vctx != NULL;
+}
+
+void vad_stream_begin(void) {
+	std::lock_guard<std::mutex> lock(state_mutex);
+	pending.clear();
+	pending_offset = 0;
+	probs.clear();
+	generation++;
+}
+
+void vad_stream_feed(const float *samples, int n_samples) {
+	if (!vctx || !samples || n_samples <= 0) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(state_mutex);
+		pending.insert(pending.end(), samples, samples + n_samples);
+	}
+	state_cv.notify_one();
+}
+
+VadTimeline *vad_stream_take(void) {
+	if (!vctx) {
+		return NULL;
+	}
+
+	VadTimeline *timeline = new VadTimeline();
+	std::lock_guard<std::mutex> lock(state_mutex);
+	// A block still being scored belongs to this recording too; it is dropped
+	// here and scored again from the samples by vad_stream_compact()
+	timeline->probs.swap(probs);
+	pending.clear();
+	pending_offset = 0;
+	generation++;
+	return timeline;
+}
+
+void vad_timeline_free(VadTimeline *timeline) {
+	delete timeline;
+}
+
+float *vad_stream_compact(VadTimeline *timeline, const float *samples, int n_samples, int *n_speech) {
+	if (!timeline || !samples || n_samples <= 0) {
+		vad_timeline_free(timeline);
+		return NULL;
+	}
+
+	double start = utils_now();
+	std::vector<float> &window_probs = timeline->probs;
+
+	// Score whatever the worker hadn't reached when the recording stopped
+	const int scored = std::min((int) window_probs.size() * VAD_WINDOW_SAMPLES, n_samples);
+	const int tail_samples = n_samples - scored;
+	window_probs.resize(scored / VAD_WINDOW_SAMPLES);
+	if (tail_samples >= VAD_WINDOW_SAMPLES) {
+		std::vector<float> tail_probs = score_block(samples + scored, tail_samples);
+		tail_probs.resize(tail_samples / VAD_WINDOW_SAMPLES, 1.0f);// Keep speech if scoring failed
+		window_probs.insert(window_probs.end(), tail_probs.begin(), tail_probs.end());
+	}
+
+	std::vector<SampleSpan> spans = speech_spans(window_probs, n_samples);
+	vad_timeline_free(timeline);
+
+	// Gather the speech spans back to back with a gap of silence between them
+	int kept = 0;
+	for (size_t i = 0; i < spans.size(); i++) {
+		kept += spans[i].second - spans[i].first;
+	}
+	const int total = kept + (spans.empty() ? 0 : (int) (spans.size() - 1) * VAD_SPEECH_GAP_SAMPLES);
+	float *speech = (float *) malloc(std::max(total, 1) * sizeof(float));
+	if (!speech) {
+		log_error("ERROR: Failed to allocate memory for speech audio");
+		return NULL;
+	}
+	int length = 0;
+	for (size_t i = 0; i < spans.size(); i++) {
+		if (i > 0) {
+			memset(speech + length, 0, VAD_SPEECH_GAP_SAMPLES * sizeof(float));
+			length += VAD_SPEECH_GAP_SAMPLES;
+		}
+		memcpy(speech + length, samples + spans[i].first, (spans[i].second - spans[i].first) * sizeof(float));
+		length += spans[i].second - spans[i].first;
+	}
+
+	log_info("🎙️ Capture VAD kept %.2f of %.2f seconds in %d speech spans (%.2f seconds scored after release, "
+			 "took %.0f ms)",
+			 (float) kept / VAD_SAMPLE_RATE, (float) n_samples / VAD_SAMPLE_RATE, (int) spans.size(),
+			 (float) tail_samples / VAD_SAMPLE_RATE, (utils_now() - start) * 1000.0);
+
+	*n_speech = total;
+	return speech;
+}
@@ -0,0 +1,63 @@
+#ifndef VAD_H
+#define VAD_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Streaming voice activity detection over the capture pipeline.
+// Recorded samples are fed in as they arrive and a Silero VAD worker thread
+// builds a speech timeline while the user is still talking, so at release
+// only the speech spans have to be handed to whisper.
+
+// Load the VAD model and start the worker thread
+// Returns true on success, false on failure
+bool vad_stream_init(const char *model_path);
+
+// Stop the worker and free the VAD model
+void vad_stream_cleanup(void);
+
+// Check if the VAD stage is loaded and running
+bool vad_stream_is_ready(void);
+
+// Forget the previous recording; call before the next recording starts
+void vad_stream_begin(void);
+
+// Feed newly recorded samples (matches audio_samples_callback)
+void vad_stream_feed(const float *samples, int n_samples);
+
+// Speech probabilities of one recording, detached from the capture stage
+typedef struct VadTimeline VadTimeline;
+
+// Detach the timeline of the recording that just stopped without waiting for
+// the worker, so the next recording can start right away.
+// Returns NULL if the VAD stage isn't running.
+VadTimeline *vad_stream_take(void);
+
+// Silence placed between gathered speech spans so words don't run together
+#define VAD_SPEECH_GAP_SAMPLES (16000 / 10)
+
+// Score the recorded samples the timeline doesn't cover yet, then gather the
+// speech spans, with a little padding and VAD_SPEECH_GAP_SAMPLES of silence
+// between them, into a malloc'd buffer of *n_speech samples (0 if no speech
+// was found). Frees the timeline. Returns NULL if there is no timeline or the
+// allocation failed; the samples should be used as they are then.
+float *vad_stream_compact(VadTimeline *timeline, const float *samples, int n_samples, int *n_speech);
+
+void vad_timeline_free(VadTimeline *timeline);
+
+#ifdef __cplusplus
+}
+
+#include "whisper.h"
+
+// Silero thresholds and padding from preferences (vad_threshold_pct,
+// vad_min_speech_ms, vad_min_silence_ms, vad_speech_pad_ms), falling back to
+// whisper's defaults. Read on every call so changes apply to the next
+// dictation without reloading a model.
+struct whisper_vad_params vad_current_params(void);
+#endif
+
+#endif // VAD_H
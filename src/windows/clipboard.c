@@ -2,6 +2,7 @@
 #include "../logging.h"
 #include "../utils.h"
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include <windows.h>
 
@@ -137,4 +138,33 @@ void clipboard_paste(void) {
     } else {
         log_error("Failed to send paste command");
     }
-}
\ No newline at end of file
+}
+
+void clipboard_backspace(int count) {
+    if (count <= 0) {
+        return;
+    }
+
+    INPUT *inputs = (INPUT *) calloc((size_t) count * 2, sizeof(INPUT));
+    if (!inputs) {
+        log_error("Failed to allocate backspace input");
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        inputs[i * 2].type = INPUT_KEYBOARD;
+        inputs[i * 2].ki.wVk = VK_BACK;
+        inputs[i * 2 + 1].type = INPUT_KEYBOARD;
+        inputs[i * 2 + 1].ki.wVk = VK_BACK;
+        inputs[i * 2 + 1].ki.dwFlags = KEYEVENTF_KEYUP;
+    }
+
+    UINT sent = SendInput((UINT) count * 2, inputs, sizeof(INPUT));
+    if (sent != (UINT) count * 2) {
+        log_error("Failed to send backspaces");
+    }
+    free(inputs);
+}
+
+unsigned long long clipboard_focused_window(void) {
+    return (unsigned long long) (ULONG_PTR) GetForegroundWindow();
+}
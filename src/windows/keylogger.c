@@ -24,6 +24,7 @@ typedef struct {
 } KeyloggerContext;
 
 static KeyloggerContext *g_keylogger = NULL;
+static volatile LONG g_keystrokes = 0;
 
 // Check if two key infos match
 static bool key_info_matches(const KeyInfo *a, const KeyInfo *b) {
@@ -118,6 +119,12 @@ static bool check_combination_match(void) {
 
 // Low-level keyboard hook procedure
 LRESULT CALLBACK keyboard_proc(int nCode, WPARAM wParam, LPARAM lParam) {
+    // SendInput keystrokes, ours included, are flagged as injected
+    if (nCode >= 0 && (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN) &&
+        !(((KBDLLHOOKSTRUCT *) lParam)->flags & LLKHF_INJECTED)) {
+        g_keystrokes++;
+    }
+
     if (nCode >= 0 && g_keylogger && !g_keylogger->paused) {
         KBDLLHOOKSTRUCT *kbdStruct = (KBDLLHOOKSTRUCT *) lParam;
         bool keyDown = (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN);
@@ -265,6 +272,10 @@ void keylogger_set_combination(const KeyCombination *combo) {
     }
 }
 
+int keylogger_get_keystroke_count(void) {
+    return (int) g_keystrokes;
+}
+
 KeyCombination keylogger_get_fn_combination(void) {
     // Windows doesn't have FN key like macOS, return Right Ctrl as default
     // Right Ctrl: scancode 0x1D with extended flag
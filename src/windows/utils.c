@@ -428,6 +428,56 @@ FILE *utils_fopen_append(const char *path) {
     return (err == 0) ? file : NULL;
 }
 
+const void *utils_map_file(const char *path, size_t *size) {
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+
+    LARGE_INTEGER file_size;
+    const void *data = NULL;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping) {
+            data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping); // The view keeps the mapping alive
+            if (data) {
+                *size = (size_t) file_size.QuadPart;
+            }
+        }
+    }
+    CloseHandle(file);
+    return data;
+}
+
+void utils_unmap_file(const void *data, size_t size) {
+    (void) size;
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+}
+
+bool utils_list_dir(const char *dir, utils_dir_fn fn, void *user_data) {
+    char pattern[MAX_PATH];
+    snprintf(pattern, sizeof(pattern), "%s\\*", dir);
+
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(pattern, &data);
+    if (find == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    do {
+        if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            char path[MAX_PATH];
+            snprintf(path, sizeof(path), "%s\\%s", dir, data.cFileName);
+            fn(path, user_data);
+        }
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+    return true;
+}
+
 char *utils_strdup(const char *str) {
     return _strdup(str);
 }
@@ -494,6 +544,130 @@ void utils_mutex_unlock(utils_mutex_t* mutex) {
     }
 }
 
+struct utils_cond {
+    CONDITION_VARIABLE cv;
+};
+
+utils_cond_t* utils_cond_create(void) {
+    utils_cond_t* c = malloc(sizeof(utils_cond_t));
+    if (!c) return NULL;
+
+    InitializeConditionVariable(&c->cv);
+    return c;
+}
+
+void utils_cond_destroy(utils_cond_t* cond) {
+    free(cond); // Windows condition variables need no cleanup
+}
+
+void utils_cond_wait(utils_cond_t* cond, utils_mutex_t* mutex) {
+    if (cond && mutex) {
+        SleepConditionVariableCS(&cond->cv, &mutex->cs, INFINITE);
+    }
+}
+
+void utils_cond_signal(utils_cond_t* cond) {
+    if (cond) {
+        WakeConditionVariable(&cond->cv);
+    }
+}
+
+void utils_cond_broadcast(utils_cond_t* cond) {
+    if (cond) {
+        WakeAllConditionVariable(&cond->cv);
+    }
+}
+
 void* utils_thread_id(void) {
     return (void*)(uintptr_t)GetCurrentThreadId();
 }
+
+// Joinable thread implementation using _beginthreadex
+struct utils_thread {
+    HANDLE handle;
+    utils_thread_fn fn;
+    void* arg;
+};
+
+static unsigned __stdcall utils_thread_entry(void* data) {
+    utils_thread_t* t = (utils_thread_t*) data;
+    t->fn(t->arg);
+    return 0;
+}
+
+utils_thread_t* utils_thread_create(utils_thread_fn fn, void* arg) {
+    utils_thread_t* t = malloc(sizeof(utils_thread_t));
+    if (!t) return NULL;
+
+    t->fn = fn;
+    t->arg = arg;
+    t->handle = (HANDLE) _beginthreadex(NULL, 0, utils_thread_entry, t, 0, NULL);
+    if (!t->handle) {
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+void utils_thread_join(utils_thread_t* thread) {
+    if (thread) {
+        WaitForSingleObject(thread->handle, INFINITE);
+        CloseHandle(thread->handle);
+        free(thread);
+    }
+}
+
+bool utils_get_cpu_info(utils_cpu_info_t *info) {
+    if (!info) {
+        return false;
+    }
+
+    SYSTEM_INFO sysinfo;
+    GetSystemInfo(&sysinfo);
+    info->logical_cpus = (int) sysinfo.dwNumberOfProcessors;
+    info->physical_cores = info->logical_cpus;
+    info->performance_cores = info->logical_cpus;
+    snprintf(info->name, sizeof(info->name), "unknown");
+
+    DWORD name_size = sizeof(info->name);
+    RegGetValueA(HKEY_LOCAL_MACHINE, "HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0", "ProcessorNameString",
+                 RRF_RT_REG_SZ, NULL, info->name, &name_size);
+
+    // One entry per physical core; EfficiencyClass is highest on performance cores
+    DWORD length = 0;
+    GetLogicalProcessorInformationEx(RelationProcessorCore, NULL, &length);
+    if (length == 0) {
+        return false;
+    }
+    char *buffer = malloc(length);
+    if (!buffer) {
+        return false;
+    }
+    if (!GetLogicalProcessorInformationEx(RelationProcessorCore, (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX) buffer,
+                                          &length)) {
+        free(buffer);
+        return false;
+    }
+
+    int n_cores = 0;
+    int n_perf = 0;
+    BYTE max_class = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (DWORD offset = 0; offset < length;) {
+            PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX entry = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX) (buffer + offset);
+            BYTE efficiency_class = entry->Processor.EfficiencyClass;
+            if (pass == 0) {
+                n_cores++;
+                if (efficiency_class > max_class) max_class = efficiency_class;
+            } else if (efficiency_class == max_class) {
+                n_perf++;
+            }
+            offset += entry->Size;
+        }
+    }
+    free(buffer);
+
+    info->physical_cores = n_cores;
+    info->performance_cores = n_perf > 0 ? n_perf : n_cores;
+    return true;
+}